@@ -121,10 +121,13 @@ let stmtCount = Cfg.start_id
 let funCount = ref 0
 let branches = ref []
 let curBranches = ref []
+let funcIds = ref []
 (* Control-flow graph is stored inside the CIL AST. *)
 
 let getNewId () = ((idCount := !idCount + 1); !idCount)
 let addBranchPair bp = (curBranches := bp :: !curBranches)
+(* Record the id of the function about to be added (see writeFuncIds). *)
+let addFuncId f = (funcIds := (!funCount + 1, f) :: !funcIds)
 let addFunction () = (branches := (!funCount, !curBranches) :: !branches;
           curBranches := [];
           funCount := !funCount + 1)
@@ -166,6 +169,19 @@ let writeBranches () =
     with x ->
       prerr_string "Failed to write branches.\n"
 
+(* "fid name file" for each instrumented function, for selecting
+ * symbolic regions (run_crown's -SYMBOLIC_FUNCS). *)
+let writeFuncIds () =
+  let writeEntry out (fid, f) =
+    Printf.fprintf out "%d %s %s\n" fid f.vname f.vdecl.file
+  in
+    try
+      let out = open_append "func_ids" in
+        List.iter (writeEntry out) (List.rev !funcIds) ;
+        close_out out
+    with x ->
+      prerr_string "Failed to write function ids.\n"
+
 (* Visitor which walks the CIL AST, printing the (already computed) CFG. *)
 class writeCfgVisitor out firstStmtIdMap =
 object (self)
@@ -1042,13 +1058,141 @@ let hasAddress (_, off) =
       | Index (_, off)  -> containsBitField off
   in
     not (containsBitField off)
+
+(*
+ * Symbolic taint.  A flow-insensitive pass over the file finds the
+ * local variables that can never hold a value computed from a symbolic
+ * input.  Expressions over only those are concrete: they are passed to
+ * libcrown as a single concrete load, stores to them are dropped, and
+ * branches on them get just their __CrownBranch call.
+ *
+ * Globals, address-taken variables and memory reached through pointers
+ * are always assumed symbolic, as are the formals of functions that may
+ * be called from other files or through pointers, and the results of
+ * calls to functions not defined in this file.
+ *)
+let noCrownTaint = ref false
+let taintedVars : (int, unit) Hashtbl.t = Hashtbl.create 1024
+let taintedReturns : (int, unit) Hashtbl.t = Hashtbl.create 64
+let definedFuns : (int, fundec) Hashtbl.t = Hashtbl.create 64
+
+let isTaintedVar v =
+  v.vglob || v.vaddrof || Hashtbl.mem taintedVars v.vid
+
+let rec isTaintedExp e =
+  match e with
+    | Const _ | SizeOf _ | SizeOfStr _ | AlignOf _
+    | SizeOfE _ | AlignOfE _ | AddrOfLabel _ -> false
+    | Lval lv -> isTaintedLval lv
+    | UnOp (_, e', _) -> isTaintedExp e'
+    | BinOp (_, e1, e2, _) -> (isTaintedExp e1) || (isTaintedExp e2)
+    | Question (c, e1, e2, _) ->
+        (isTaintedExp c) || (isTaintedExp e1) || (isTaintedExp e2)
+    | CastE (_, e') -> isTaintedExp e'
+    | AddrOf (host, off) | StartOf (host, off) ->
+        (match host with
+           | Var _ -> isTaintedOffset off
+           | Mem e' -> (isTaintedExp e') || (isTaintedOffset off))
+
+and isTaintedLval (host, off) =
+  match host with
+    | Var v -> (isTaintedVar v) || (isTaintedOffset off)
+    | Mem _ -> true
+
+and isTaintedOffset off =
+  match off with
+    | NoOffset -> false
+    | Field (_, off') -> isTaintedOffset off'
+    | Index (e, off') -> (isTaintedExp e) || (isTaintedOffset off')
+
+let isTaintedCall fe =
+  match fe with
+    | Lval (Var f, NoOffset) ->
+        (not (Hashtbl.mem definedFuns f.vid)) || (Hashtbl.mem taintedReturns f.vid)
+    | _ -> true
+
+let isConcreteExp e = (not !noCrownTaint) && (not (isTaintedExp e))
+let isConcreteLval lv = (not !noCrownTaint) && (not (isTaintedLval lv))
+
+(* One round of taint propagation over a function; sets changed if
+ * anything new was tainted. *)
+class taintVisitor (fd : fundec) (changed : bool ref) =
+  let taintVar v =
+    if not (isTaintedVar v) then
+      (Hashtbl.replace taintedVars v.vid () ; changed := true)
+  in
+  let taintLval (host, off) =
+    match host with
+      | Var v -> taintVar v
+      | Mem _ -> ()
+  in
+  let assign (host, off) tainted =
+    if tainted || (isTaintedOffset off) then taintLval (host, off)
+  in
+  let rec taintFormals formals args =
+    match (formals, args) with
+      | (v :: vs, e :: es) ->
+          if isTaintedExp e then taintVar v ;
+          taintFormals vs es
+      | _ -> ()
+  in
+object (self)
+  inherit nopCilVisitor
+
+  method vinst(i) =
+    (match i with
+       | Set (lv, e, _) -> assign lv (isTaintedExp e)
+       | Call (ret, fe, args, _) ->
+           (match ret with
+              | Some lv -> assign lv (isTaintedCall fe)
+              | None -> ()) ;
+           (match fe with
+              | Lval (Var f, NoOffset) when Hashtbl.mem definedFuns f.vid ->
+                  taintFormals (Hashtbl.find definedFuns f.vid).sformals args
+              | _ -> ())
+       | Asm (_, _, outs, _, _, _) ->
+           List.iter (fun (_, _, lv) -> taintLval lv) outs) ;
+    SkipChildren
+
+  method vstmt(s) =
+    (match s.skind with
+       | Return (Some e, _) ->
+           if (isTaintedExp e) && not (Hashtbl.mem taintedReturns fd.svar.vid) then
+             (Hashtbl.replace taintedReturns fd.svar.vid () ; changed := true)
+       | _ -> ()) ;
+    DoChildren
+end
+
+let computeTaint f =
+  Hashtbl.clear taintedVars ;
+  Hashtbl.clear taintedReturns ;
+  Hashtbl.clear definedFuns ;
+  let funs =
+    mapOptional (function GFun (fd, _) -> Some fd | _ -> None) f.globals
+  in
+    List.iter (fun fd -> Hashtbl.replace definedFuns fd.svar.vid fd) funs ;
+    (* Anyone may pass symbolic arguments to these. *)
+    List.iter
+      (fun fd ->
+         if fd.svar.vstorage <> Static || fd.svar.vaddrof then
+           List.iter (fun v -> Hashtbl.replace taintedVars v.vid ()) fd.sformals)
+      funs ;
+    let changed = ref true in
+      while !changed do
+        changed := false ;
+        List.iter
+          (fun fd ->
+             let tv = new taintVisitor fd changed in
+               ignore (visitCilFunction (tv :> cilVisitor) fd))
+          funs
+      done
+
 (* 
  * written by Hyunwoo Kim (17.07.13)
  * arguments, line and file name, were added to __CrownBranch function.
  *)
 let lineArg = ("line", lineType,      [])
 let fnameArg = ("fname", fnameType,   [])
-let fname2Arg = ("fname2", fnameType,   [])
 let idArg   = ("id",   idType,        [])
 let bidArg  = ("bid",  bidType,       [])
 let fidArg  = ("fid",  fidType,       [])
@@ -1064,8 +1208,11 @@ let nameArg = ("name", charptrType, [])
 let mkInstFunc f name args =
   let ty = TFun (voidType, Some (idArg :: args), false, []) in
   let func = findOrCreateFunc f ("__Crown" ^ name) ty in
-    func.vstorage <- Extern ;
-    func.vattr <- [Attr ("crown_skip", [])] ;
+    (* Leave the static inline fast paths of crown.h as they are. *)
+    if func.vstorage <> Static then begin
+      func.vstorage <- Extern ;
+      func.vattr <- [Attr ("crown_skip", [])]
+    end ;
     func
 
 let mkInstCall func args =
@@ -1122,12 +1269,18 @@ class crownInstrumentVisitor f =
  * arguments, line and file name, were added to __CrownBranch function.
  *)
   let branchFunc       = mkInstFunc f "Branch" [bidArg; boolArg; lineArg; fnameArg] in
+  let load2Apply2Func  = mkInstFunc f "Load2Apply2"
+                           [("addr1", addrType, []); ("type1", typeType, []);
+                            ("val1", valType, []); ("fp_val1", valFpType, []);
+                            ("addr2", addrType, []); ("type2", typeType, []);
+                            ("val2", valType, []); ("fp_val2", valFpType, []);
+                            opArg; typeArg; valArg; valFpArg] in
+  let compareBranchFunc = mkInstFunc f "CompareBranch" [opArg; typeArg; bidArg; boolArg; lineArg; fnameArg] in
   let callFunc         = mkInstFunc f "Call" [fidArg] in
   let returnFunc       = mkInstFunc f "Return" [] in
   let handleReturnFunc = mkInstFunc f "HandleReturn" [typeArg; valArg; valFpArg] in
-  let setCallerCalleeNameFunc    = mkInstFunc f "SetCallerCalleeName" [fnameArg; fname2Arg] in
-  let enableSymbolicFunc   = mkInstFunc f "EnableSymbolic" [fnameArg] in
-  let checkSymbolicFunc = mkInstFunc f "CheckSymbolic" [fnameArg] in
+  let setCalleeFunc    = mkInstFunc f "SetCallee" [addrArg] in
+  let checkSymbolicFunc = mkInstFunc f "CheckSymbolic" [fidArg; addrArg] in
 
   (*
    * Functions to create calls to the above instrumentation functions.
@@ -1232,12 +1385,18 @@ class crownInstrumentVisitor f =
    * __LINE__ and __FILE__ directives were added as parameter of __CrownBranch function.
    *)
   let mkBranch bid b      = mkInstCall branchFunc [integer bid; integer b; mkString "__LINE__"; mkString "__FILE__"] in
+  let mkLoad2Apply2 (addr1, ty1, v1) (addr2, ty2, v2) op ty v =
+    mkInstCall load2Apply2Func
+      [toAddr addr1; toType ty1; loadVal ty1 v1; loadFpVal ty1 v1;
+       toAddr addr2; toType ty2; loadVal ty2 v2; loadFpVal ty2 v2;
+       binaryOp op; toType ty; toValue v; loadFpVal ty v] in
+  let mkCompareBranch op ty bid b =
+    mkInstCall compareBranchFunc [binaryOp op; toType ty; integer bid; integer b; mkString "__LINE__"; mkString "__FILE__"] in
   let mkCall fid          = mkInstCall callFunc [integer fid] in
   let mkReturn ()         = mkInstCall returnFunc [] in
   let mkHandleReturn ty v = mkInstCall handleReturnFunc [toType ty; loadVal ty v; loadFpVal ty v] in
-  let mkSetCallerCalleeName caller callee = mkInstCall setCallerCalleeNameFunc [mkString caller; mkString callee] in
-  let mkEnableSymbolic caller = mkInstCall enableSymbolicFunc [mkString caller] in
-  let mkCheckSymbolic callee = mkInstCall checkSymbolicFunc [mkString callee] in
+  let mkSetCallee f       = mkInstCall setCalleeFunc [toAddr (AddrOf (var f))] in
+  let mkCheckSymbolic fid f = mkInstCall checkSymbolicFunc [integer fid; toAddr (AddrOf (var f))] in
 
   (*
    * Instrument an expression.
@@ -1326,13 +1485,10 @@ class crownInstrumentVisitor f =
 				|_ -> ""
 		in*)
     let ty = typeOf e in
-    if isConstant e then
-      [mkLoad noAddr ty e (*(constToStr e)*)]
-    else
+    match leafLoad e with
+      | Some (addr, _, _) -> [mkLoad addr ty e (*(constToStr e)*)]
+      | None ->
       match e with
-        | Lval lv when hasAddress lv ->
-              [mkLoad (addressOf lv) ty e]
-
         | UnOp (op, e', _) ->
             (* Should skip this if we don't currently handle 'op'? *)
             (instrumentExpr e') @ [mkApply1 op ty e]
@@ -1340,9 +1496,12 @@ class crownInstrumentVisitor f =
         | BinOp (op, e1, e2, _) ->
             (* Should skip this if we don't currently handle 'op'? *)
             let signed = isSignedType (typeOf e1) in
+            (match (leafLoad e1, leafLoad e2) with
+               | (Some l1, Some l2) -> [mkLoad2Apply2 l1 l2 (signed, op) ty e]
+               | _ ->
               (instrumentExpr e1)
               @ (instrumentExpr e2)
-              @ [mkApply2 (signed, op) ty e]
+              @ [mkApply2 (signed, op) ty e])
 
         | CastE (_, e') when isStructureType ty ->
             (* Structure casts are meaningless -- just adding or
@@ -1353,8 +1512,27 @@ class crownInstrumentVisitor f =
             let signed = isSignedType (typeOf e') in
               (instrumentExpr e') @ [mkCast signed ty e]
 
+        | _ -> invalid_arg "instrumentExpr"
+
+  (*
+   * Expressions instrumented by a single load: (address, type, value).
+   *)
+  and leafLoad e =
+    let ty = typeOf e in
+    if isConstant e || isConcreteExp e then
+      Some (noAddr, ty, e)
+    else
+      match e with
+        | Lval lv when hasAddress lv -> Some (addressOf lv, ty, e)
+        | UnOp _ | BinOp _ | CastE _ -> None
         (* Default case: sizeof() and __alignof__() expressions. *)
-        | _ -> [mkLoad noAddr ty e]
+        | _ -> Some (noAddr, ty, e)
+  in
+
+  let isCompareOp op =
+    match op with
+      | Eq | Ne | Lt | Gt | Le | Ge -> true
+      | _ -> false
   in
 
 object (self)
@@ -1365,11 +1543,26 @@ object (self)
    *)
   method vstmt(s) =
     match s.skind with
+      (* The comparison is done together with the branch in each arm. *)
+      | If (BinOp (op, e1, e2, _) as e, b1, b2, _)
+          when isCompareOp op && not (isConcreteExp e) ->
+          let getFirstStmtId blk = (List.hd blk.bstmts).sid in
+          let b1_sid = getFirstStmtId b1 in
+          let b2_sid = getFirstStmtId b2 in
+          let signed = isSignedType (typeOf e1) in
+          let ty = typeOf e in
+            (self#queueInstr ((instrumentExpr e1) @ (instrumentExpr e2)) ;
+             prependToBlock [mkCompareBranch (signed, op) ty b1_sid 1] b1 ;
+             prependToBlock [mkCompareBranch (signed, op) ty b2_sid 0] b2 ;
+             addBranchPair (b1_sid, b2_sid)) ;
+          DoChildren
+
       | If (e, b1, b2, _) ->
           let getFirstStmtId blk = (List.hd blk.bstmts).sid in
           let b1_sid = getFirstStmtId b1 in
           let b2_sid = getFirstStmtId b2 in
-            (self#queueInstr (instrumentExpr e) ;
+            (if not (isConcreteExp e) then
+               self#queueInstr (instrumentExpr e) ;
               prependToBlock [mkBranch b1_sid 1] b1 ;
                prependToBlock [mkBranch b2_sid 0] b2 ;
              addBranchPair (b1_sid, b2_sid)) ;
@@ -1392,6 +1585,10 @@ object (self)
    *)
   method vinst(i) =
       match i with
+      (* Never symbolic, and only ever read by value (see isConcreteExp). *)
+      | Set (lv, e, loc) when hasAddress lv && isConcreteLval lv ->
+            SkipChildren
+
       | Set (lv, e, loc) when (true && hasAddress lv)(*type is ok, lv has addr *) ->
         (* If lv is an aggregate, it must be a struct/union. *)
             (self#queueInstr (instrumentExpr e) ;
@@ -1399,13 +1596,11 @@ object (self)
              SkipChildren)
           
       (* Don't instrument calls to functions marked as uninstrumented
-       * except caller-callee name setting. *)
+       * except setting the callee (see __CrownCheckSymbolic). *)
       | Call (ret, Lval (Var f, NoOffset), _, _)
           when shouldSkipFunction f -> 
               if ((isProbeFunction f) == false)
-              then
-                  ChangeTo [mkSetCallerCalleeName curFunc.svar.vname f.vname;
-                  i; mkEnableSymbolic curFunc.svar.vname;]
+              then ChangeTo [mkSetCallee f; i]
               else SkipChildren
 
       | Call (ret, Lval (Var f, NoOffset), args, loc) ->
@@ -1413,13 +1608,14 @@ object (self)
          let isSymbolicLval lv = isSymbolicType (typeOfLval lv) in
          let argsToInst = List.filter isSymbolicExp args in
            self#queueInstr (concatMap instrumentExpr argsToInst) ;
-           self#queueInstr [mkSetCallerCalleeName curFunc.svar.vname f.vname];
+           self#queueInstr [mkSetCallee f];
          (match ret with
-            | Some lv when ((isSymbolicLval lv) && (hasAddress lv)) ->
-              ChangeTo [i ; mkEnableSymbolic curFunc.svar.vname;
+            | Some lv when ((isSymbolicLval lv) && (hasAddress lv)
+                            && not (isConcreteLval lv)) ->
+              ChangeTo [i ;
                         mkHandleReturn (typeOfLval lv) (Lval lv) ;
                         mkStore (addressOf lv)]
-            | _ -> ChangeTo [i ; mkEnableSymbolic curFunc.svar.vname; mkClearStack ()])
+            | _ -> ChangeTo [i ; mkClearStack ()])
        | _ -> DoChildren
 
   (*
@@ -1439,6 +1635,7 @@ object (self)
       let isSymbolic v = isSymbolicType v.vtype in
       let (_, _, isVarArgs, _) = splitFunctionType f.svar.vtype in
       let paramsToInst = List.filter isSymbolic f.sformals in
+        addFuncId f.svar ;
         addFunction () ;
         (* 
          * skip instrumenting parameters of main because
@@ -1454,7 +1651,7 @@ object (self)
              );
           
         prependToBlock [mkCall !funCount] f.sbody ;
-        prependToBlock [mkCheckSymbolic f.svar.vname] f.sbody ;
+        prependToBlock [mkCheckSymbolic !funCount f.svar] f.sbody ;
         DoChildren
 
 end
@@ -1474,7 +1671,9 @@ let feature : featureDescr =
   { fd_name = "CrownInstrument";
     fd_enabled = ref false;
     fd_description = "instrument a program for use with CROWN";
-    fd_extraopt = [];
+    fd_extraopt = [
+      ("--crownNoTaint", Arg.Set noCrownTaint,
+       " Instrument code that can never depend on symbolic inputs too")];
     fd_post_check = true;
     fd_doit =
       function (f: file) ->
@@ -1509,6 +1708,8 @@ let feature : featureDescr =
     (*(let bitfieldVisitor = new crownbitfieldInstrumentVisitor f in
              visitCilFileSameGlobals (bitfieldVisitor :> cilVisitor) f) ; *)
   
+          (* Find the variables that are never symbolic. *)
+          computeTaint f ;
           (* Finally instrument the program. *)
     (let instVisitor = new crownInstrumentVisitor f in
              visitCilFileSameGlobals (instVisitor :> cilVisitor) f) ;
@@ -1518,5 +1719,6 @@ let feature : featureDescr =
           writeIdCount () ;
           writeStmtCount () ;
           writeFunCount () ;
-          writeBranches ());
+          writeBranches () ;
+          writeFuncIds ());
   }
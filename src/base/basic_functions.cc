@@ -6,6 +6,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include <limits>
 #include <string>
 #include <sstream>
@@ -110,5 +111,44 @@ double setDoubleByInts(int sign, long long int exp, long long unsigned int sig){
 	return *reinterpret_cast<double*>(&intNum);
 }
 
-}  // namespace crown
+InputRecord ValueToInputRecord(const Value_t& val, unsigned char h,
+		unsigned char l, unsigned char index_size){
+	InputRecord rec;
+	rec.type = static_cast<signed char>(val.type);
+	rec.h = h;
+	rec.l = l;
+	rec.index_size = index_size;
+	rec.reserved = 0;
+	rec.bits = 0;
+
+	if(val.type == types::FLOAT){
+		float f = (float)val.floating;
+		unsigned int bits;
+		memcpy(&bits, &f, sizeof(bits));
+		rec.bits = bits;
+	}else if(val.type == types::DOUBLE){
+		memcpy(&rec.bits, &val.floating, sizeof(rec.bits));
+	}else{
+		rec.bits = static_cast<unsigned long long>(val.integral);
+	}
+	return rec;
+}
 
+Value_t InputRecordToValue(const InputRecord& rec){
+	Value_t val;
+	val.type = static_cast<type_t>(rec.type);
+
+	if(val.type == types::FLOAT){
+		unsigned int bits = static_cast<unsigned int>(rec.bits);
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		val.floating = f;
+	}else if(val.type == types::DOUBLE){
+		memcpy(&val.floating, &rec.bits, sizeof(val.floating));
+	}else{
+		val.integral = static_cast<value_t>(rec.bits);
+	}
+	return val;
+}
+
+}  // namespace crown
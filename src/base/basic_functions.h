@@ -21,6 +21,11 @@ namespace crown {
 	float setFloatByInts(int sign, long long int exp, long long unsigned int sig);
 	double setDoubleByInts(int sign, long long int exp, long long unsigned int sig);
 
+	// Conversions between values and binary input-file records.
+	InputRecord ValueToInputRecord(const Value_t& val, unsigned char h,
+			unsigned char l, unsigned char index_size);
+	Value_t InputRecordToValue(const InputRecord& rec);
+
 	//To print out concrete arrays
 }
 
@@ -115,6 +115,60 @@ typedef struct Value_t{
 		integral(integral_), floating(floating_), type(type_){}
 }Value_t;
 
+/*
+ * Header at the start of szd_execution.  Section offsets are absolute
+ * byte offsets from the beginning of the file, so a reader can seek
+ * directly to the sections it needs (e.g. branches only).
+ */
+static const unsigned int kExecutionMagic = 0x4e575243;  // "CRWN"
+static const unsigned int kExecutionVersion = 3;
+
+typedef struct ExecutionHeader{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long inputs_offset;
+	unsigned long long tracker_offset;
+	unsigned long long branches_offset;
+	unsigned long long constraints_offset;
+	unsigned long long hits_offset;
+	ExecutionHeader() : magic(kExecutionMagic), version(kExecutionVersion),
+		inputs_offset(0), tracker_offset(0),
+		branches_offset(0), constraints_offset(0), hits_offset(0){}
+}ExecutionHeader;
+
+/*
+ * Binary test-case ("input") file: kInputMagic followed by one
+ * InputRecord per symbolic input.  bits holds the value as is: raw IEEE
+ * bits for FLOAT (low 32 bits) and DOUBLE, two's complement otherwise.
+ * Files without the magic are read as the older text format.
+ */
+static const unsigned int kInputMagic = 0x4e495243;  // "CRIN"
+
+typedef struct InputRecord{
+	signed char type;
+	unsigned char h;
+	unsigned char l;
+	unsigned char index_size;
+	unsigned int reserved;
+	unsigned long long bits;
+}InputRecord;
+
+/*
+ * Test cases saved with -TCDIR are appended, one binary input file after
+ * another, to kTestCasePack in that directory.  kTestCaseIndex holds one
+ * TestCaseIndex per test case, giving the iteration that produced it and
+ * where its input file lies in the pack.
+ */
+static const char kTestCasePack[] = "inputs.pack";
+static const char kTestCaseIndex[] = "inputs.idx";
+
+typedef struct TestCaseIndex{
+	unsigned int iteration;
+	unsigned int reserved;
+	unsigned long long offset;
+	unsigned long long length;
+}TestCaseIndex;
+
 extern const char* kMinValueStr[];
 extern const char* kMaxValueStr[];
 
@@ -18,6 +18,7 @@
 #include <sstream>
 #include <stdarg.h>
 #include <cstring>
+#include <cstdlib>
 
 #include "libcrown/symbolic_interpreter.h"
 #include "base/basic_types.h"
@@ -34,11 +35,16 @@ static SymbolicInterpreter* SI = NULL;
 
 static map<void *, void *> AddrMap;
 
-// Have we read an input yet?  Until we have, generate only the
-// minimal instrumentation necessary to track which branches were
-// reached by the execution path.
+// Generate only the minimal instrumentation necessary to track which
+// branches were reached by the execution path?  Set once by __CrownInit
+// and only read afterwards, so all threads can share it.
 static int pre_symbolic;
 
+// Branch-only mode (CROWN_BRANCH_ONLY set in the environment): stay in
+// the pre-symbolic state for the whole run, so only branch ids (and the
+// inputs) are recorded and no symbolic expressions are built.
+static int branch_only;
+
 // Tables for converting from operators defined in libcrown/crown.h to
 // those defined in base/basic_types.h.
 static const int kOpTable[] = {
@@ -63,8 +69,96 @@ static const int kOpTable[] = {
 	ops::SUBTRACT_PP,
 };
 
-static char caller[256], callee[256];
-static int enable_symbolic = 1;
+// Symbolic regions.  Each thread keeps a stack of its instrumented
+// frames (pushed by __CrownCheckSymbolic, popped by __CrownReturn).  A
+// frame entered from un-instrumented code (e.g., a qsort comparator)
+// disables symbolic execution until it returns.  Given an allowlist of
+// function ids (CROWN_SYMBOLIC_FUNCS), branches only yield constraints
+// within the dynamic extent of a listed function.
+struct Frame {
+	__CROWN_FUNCTION_ID fid;
+	bool allowed;
+	bool callback;
+};
+static thread_local vector<Frame> frames;
+static thread_local size_t allowed_depth, callback_depth;
+static thread_local __CROWN_ADDR expected_callee;
+static thread_local int enable_symbolic = 1;
+
+// Bitmap of allowed function ids; empty if every function is allowed.
+static vector<unsigned long long> allowlist;
+
+static inline bool IsAllowed(__CROWN_FUNCTION_ID fid) {
+	if (allowlist.empty())
+		return true;
+	size_t w = fid / 64;
+	return (w < allowlist.size()) && ((allowlist[w] >> (fid % 64)) & 1);
+}
+
+static inline bool InSymbolicRegion() {
+	return allowlist.empty() || (allowed_depth > 0);
+}
+
+// Pops the frame of the returning function.
+static inline void PopFrame() {
+	if (frames.empty())
+		return;
+	allowed_depth -= frames.back().allowed;
+	callback_depth -= frames.back().callback;
+	frames.pop_back();
+	enable_symbolic = (callback_depth == 0);
+}
+
+// Reads the function ids to allow, one per line.  Only the first field
+// of each line is used, so crownc's func_ids ("fid name file") or any
+// subset of its lines can be given as is.
+static void LoadAllowlist(const char* fname) {
+	std::ifstream in(fname);
+	if (!in) {
+		std::cerr<<"Error: cannot read CROWN_SYMBOLIC_FUNCS file "
+			<<fname<<std::endl;
+		exit(1);
+	}
+	string line;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		unsigned long fid;
+		if (!(fields >> fid))
+			continue;  // Blank or malformed line.
+		if (fid / 64 >= allowlist.size())
+			allowlist.resize(fid / 64 + 1, 0);
+		allowlist[fid / 64] |= 1ULL << (fid % 64);
+	}
+	if (allowlist.empty())
+		allowlist.push_back(0);  // An empty list allows nothing.
+
+	// Frames entered before __CrownInit (i.e., main).
+	allowed_depth = 0;
+	for (size_t i = 0; i < frames.size(); i++) {
+		frames[i].allowed = IsAllowed(frames[i].fid);
+		allowed_depth += frames[i].allowed;
+	}
+}
+
+// Mirrors SI and pre_symbolic for the inline fast paths in crown.h.
+// Clear until __CrownInit, which sets it once, before the program can
+// start other threads; afterwards it is only read.
+int __CrownState = 0;
+
+static inline void UpdateState() {
+	int state = 0;
+	if (SI != NULL) {
+		state |= __CROWN_STATE_ENABLED;
+		if (!pre_symbolic)
+			state |= __CROWN_STATE_TRACING;
+	}
+	__CrownState = state;
+}
+
+static inline void SetPreSymbolic(int v) {
+	pre_symbolic = v;
+	UpdateState();
+}
 
 static void __CrownAtExit();
 
@@ -170,11 +264,33 @@ void __CrownInit(__CROWN_ID id) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif // MALLOC_HOOK_ENABLED
+	branch_only = (getenv("CROWN_BRANCH_ONLY") != NULL);
+
 	vector<Value_t> input;
-	std::ifstream in("input");
+	std::ifstream in("input", std::ios::in | std::ios::binary);
 	Value_t val;
 	int varType;
 	char* buf = new char[128];
+
+	// Binary input file: raw values, no text conversion.
+	unsigned int magic = 0;
+	in.read((char*)&magic, sizeof(magic));
+	if (in && (magic == kInputMagic)) {
+		InputRecord rec;
+		while (in.read((char*)&rec, sizeof(rec))) {
+			val = InputRecordToValue(rec);
+#ifdef DISABLE_FP
+			assert(val.type != FLOAT && val.type != DOUBLE
+					&& "FP type cannot be the input value");
+#endif
+			input.push_back(val);
+		}
+	} else {
+		// Older text format.
+		in.clear();
+		in.seekg(0);
+	}
+
 	while (in >>varType){
 		val.type = (type_t) varType;
 
@@ -208,7 +324,16 @@ void __CrownInit(__CROWN_ID id) {
 	in.close();
 	SI = new SymbolicInterpreter(input);
 
-	pre_symbolic = 0;
+	const char* funcs = getenv("CROWN_SYMBOLIC_FUNCS");
+	if (funcs != NULL)
+		LoadAllowlist(funcs);
+
+	// Per-site constraint budget (CROWN_SITE_BUDGET, set by run_crown).
+	const char* budget = getenv("CROWN_SITE_BUDGET");
+	if (budget != NULL)
+		SI->set_site_budget(strtoul(budget, NULL, 10));
+
+	SetPreSymbolic(branch_only);
 
 	assert(!atexit(__CrownAtExit));
 #ifdef MALLOC_HOOK_ENABLED
@@ -242,6 +367,7 @@ void __CrownAtExit() {
 // Instrumentation functions.
 //
 void __CrownRegGlobal(__CROWN_ID id, __CROWN_ADDR addr, size_t size, __CROWN_TYPE ty) {
+	if (branch_only) return;
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
@@ -321,8 +447,7 @@ void __CrownAlloc(__CROWN_ID id, __CROWN_ADDR addr, size_t size) {
 #ifdef MALLOC_HOOK_ENABLED 
 	restore_original_hooks();
 #endif
-    if (!enable_symbolic) return;
-	pre_symbolic = 0;
+    if (!enable_symbolic || branch_only) return;
 	SI->Alloc(id, addr, size);
 #ifdef MALLOC_HOOK_ENABLED
 	save_original_hooks();
@@ -334,7 +459,7 @@ void __CrownFree(__CROWN_ID id, __CROWN_ADDR addr){
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-    if (!enable_symbolic) return;
+    if (!enable_symbolic || branch_only) return;
 	SI->Free(id, addr);
 #ifdef MALLOC_HOOK_ENABLED
 	save_original_hooks();
@@ -472,6 +597,42 @@ void __CrownApply2(__CROWN_ID id, __CROWN_OP op,
 #endif
 }
 
+void __CrownLoad2Apply2(__CROWN_ID id,
+		__CROWN_ADDR addr1, __CROWN_TYPE ty1, __CROWN_VALUE val1, __CROWN_FP_VALUE fp_val1,
+		__CROWN_ADDR addr2, __CROWN_TYPE ty2, __CROWN_VALUE val2, __CROWN_FP_VALUE fp_val2,
+		__CROWN_OP op, __CROWN_TYPE ty, __CROWN_VALUE val, __CROWN_FP_VALUE fp_val) {
+#ifdef MALLOC_HOOK_ENABLED
+	restore_original_hooks();
+#endif
+    if (!enable_symbolic) return;
+	assert((op >= __CROWN_ADD) && (op <= __CROWN_CONCRETE));
+
+#ifdef DISABLE_FP
+	if( 12 <= ty1 && ty1 <= 14){ ty1 = 5; } // int
+	if( 12 <= ty2 && ty2 <= 14){ ty2 = 5; } // int
+	if( 12 <= ty && ty <= 14){ ty = 5; } // int
+#endif
+
+	if (pre_symbolic)
+		return;
+
+	Value_t v1(val1, fp_val1, static_cast<type_t>(ty1));
+	Value_t v2(val2, fp_val2, static_cast<type_t>(ty2));
+	if ((op >= __CROWN_EQ) && (op <= __CROWN_S_GEQ)) {
+		SI->LoadApplyCompareOp(id, addr1, v1, addr2, v2,
+				static_cast<compare_op_t>(kOpTable[op]),
+				Value_t(val,fp_val,static_cast<type_t>(ty)));
+	} else {
+		SI->LoadApplyBinaryOp(id, addr1, v1, addr2, v2,
+				static_cast<binary_op_t>(kOpTable[op]),
+				Value_t(val,fp_val,static_cast<type_t>(ty)));
+	}
+#ifdef MALLOC_HOOK_ENABLED
+	save_original_hooks();
+	install_crown_hooks();
+#endif
+}
+
 void __CrownPtrApply2(__CROWN_ID id, __CROWN_OP op,
 		size_t size, __CROWN_VALUE val) {
 #ifdef MALLOC_HOOK_ENABLED
@@ -496,6 +657,9 @@ void __CrownBranch(__CROWN_ID id, __CROWN_BRANCH_ID bid, __CROWN_BOOL b,
 	if (pre_symbolic) {
 		// Precede the branch with a fake (concrete) load.
 		SI->Load(id, 0, Value_t(b, b, types::CHAR));
+	} else if (!InSymbolicRegion()) {
+		// Record the branch, but not its constraint.
+		SI->ClearStack(id);
 	}
     /*
      * written by Hyunwoo Kim (17.07.13)
@@ -509,6 +673,33 @@ void __CrownBranch(__CROWN_ID id, __CROWN_BRANCH_ID bid, __CROWN_BOOL b,
 }
 
 
+// The comparison's value is the branch direction b.
+void __CrownCompareBranch(__CROWN_ID id, __CROWN_OP op, __CROWN_TYPE ty,
+		__CROWN_BRANCH_ID bid, __CROWN_BOOL b,
+		__CROWN_LINE_NO l, __CROWN_FILE_NAME f) {
+#ifdef MALLOC_HOOK_ENABLED
+	restore_original_hooks();
+#endif
+    if (!enable_symbolic) return;
+	assert((op >= __CROWN_EQ) && (op <= __CROWN_S_GEQ));
+	if (pre_symbolic) {
+		// Precede the branch with a fake (concrete) load.
+		SI->Load(id, 0, Value_t(b, b, types::CHAR));
+	} else if (!InSymbolicRegion()) {
+		SI->ClearStack(id);
+	} else {
+		SI->ApplyCompareOp(id,
+				static_cast<compare_op_t>(kOpTable[op]),
+				Value_t(b, b, static_cast<type_t>(ty)));
+	}
+	SI->Branch(id, bid, static_cast<bool>(b), l-1, f, NULL);
+#ifdef MALLOC_HOOK_ENABLED
+	save_original_hooks();
+	install_crown_hooks();
+#endif
+}
+
+
 void __CrownCall(__CROWN_ID id, __CROWN_FUNCTION_ID fid) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
@@ -527,8 +718,10 @@ void __CrownReturn(__CROWN_ID id) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-    if (!enable_symbolic) return;
-	SI->Return(id);
+	bool enabled = enable_symbolic;
+	PopFrame();
+	if (enabled)
+		SI->Return(id);
 #ifdef MALLOC_HOOK_ENABLED
 	save_original_hooks();
 	install_crown_hooks();
@@ -553,6 +746,28 @@ void __CrownHandleReturn(__CROWN_ID id, __CROWN_TYPE ty, __CROWN_VALUE val, __CR
 }
 
 
+// Entry points for the inline fast paths in crown.h.  They re-check the
+// state, so they are simply the callbacks above.
+#define SLOW_PATH(name) __attribute__((alias(#name)))
+void __CrownLoadSlow(__CROWN_ID, __CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) SLOW_PATH(__CrownLoad);
+void __CrownDerefSlow(__CROWN_ID, __CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) SLOW_PATH(__CrownDeref);
+void __CrownStoreSlow(__CROWN_ID, __CROWN_ADDR) SLOW_PATH(__CrownStore);
+void __CrownWriteSlow(__CROWN_ID, __CROWN_ADDR) SLOW_PATH(__CrownWrite);
+void __CrownClearStackSlow(__CROWN_ID) SLOW_PATH(__CrownClearStack);
+void __CrownApply1Slow(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) SLOW_PATH(__CrownApply1);
+void __CrownApply2Slow(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) SLOW_PATH(__CrownApply2);
+void __CrownLoad2Apply2Slow(__CROWN_ID,
+		__CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE,
+		__CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE,
+		__CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) SLOW_PATH(__CrownLoad2Apply2);
+void __CrownCompareBranchSlow(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_BRANCH_ID, __CROWN_BOOL, __CROWN_LINE_NO, __CROWN_FILE_NAME) SLOW_PATH(__CrownCompareBranch);
+void __CrownBranchSlow(__CROWN_ID, __CROWN_BRANCH_ID, __CROWN_BOOL, __CROWN_LINE_NO, __CROWN_FILE_NAME, __CROWN_EXP) SLOW_PATH(__CrownBranch);
+void __CrownCallSlow(__CROWN_ID, __CROWN_FUNCTION_ID) SLOW_PATH(__CrownCall);
+void __CrownReturnSlow(__CROWN_ID) SLOW_PATH(__CrownReturn);
+void __CrownHandleReturnSlow(__CROWN_ID, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) SLOW_PATH(__CrownHandleReturn);
+#undef SLOW_PATH
+
+
 /*
  * Symbolic input functions.
  *
@@ -569,7 +784,6 @@ void __CrownUChar(unsigned char* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;	
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -590,7 +804,6 @@ void __CrownUChar2(unsigned char* x, unsigned char val, int cnt_sym_var, int ln,
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -609,7 +822,6 @@ void __CrownUShort(unsigned short* x, int cnt_sym_var, int ln, char* fname, ...)
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -630,7 +842,6 @@ void __CrownUShort2(unsigned short* x, unsigned short val, int cnt_sym_var, int
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -650,7 +861,6 @@ void __CrownUInt(unsigned int* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -671,7 +881,6 @@ void __CrownUInt2(unsigned int* x, unsigned int val, int cnt_sym_var, int ln, ch
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -691,7 +900,6 @@ void __CrownULong(unsigned long* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -712,7 +920,6 @@ void __CrownULong2(unsigned long* x, unsigned long val, int cnt_sym_var, int ln,
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -732,7 +939,6 @@ void __CrownULongLong(unsigned long long* x, int cnt_sym_var, int ln, char* fnam
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -753,7 +959,6 @@ void __CrownULongLong2(unsigned long long* x, unsigned long long val, int cnt_sy
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -773,7 +978,6 @@ void __CrownChar(char* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 	
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -794,7 +998,6 @@ void __CrownChar2(char* x, char val, int cnt_sym_var, int ln, char* fname, ...)
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -814,7 +1017,6 @@ void __CrownShort(short* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -835,7 +1037,6 @@ void __CrownShort2(short* x, short val, int cnt_sym_var, int ln, char* fname, ..
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -855,7 +1056,6 @@ void __CrownInt(int* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -876,7 +1076,6 @@ void __CrownInt2(int* x, int val, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -896,7 +1095,6 @@ void __CrownLong(long* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -917,7 +1115,6 @@ void __CrownLong2(long* x, long val, int cnt_sym_var, int ln, char* fname, ...)
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -937,7 +1134,6 @@ void __CrownLongLong(long long* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -958,7 +1154,6 @@ void __CrownLongLong2(long long* x, long long val, int cnt_sym_var, int ln, char
 #ifdef MALLOC_HOOK_ENABLED
     restore_original_hooks();
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -983,7 +1178,6 @@ void __CrownFloat(float* x, int cnt_sym_var, int ln, char* fname, ...) {
 	assert(0 && "FP type is disabled");
 #endif
 
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -1008,7 +1202,6 @@ void __CrownFloat2(float* x, float val,  int cnt_sym_var, int ln, char* fname, .
     assert(0 && "FP type is disabled");
 #endif
 
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -1031,7 +1224,6 @@ void __CrownDouble(double* x, int cnt_sym_var, int ln, char* fname, ...) {
 #ifdef DISABLE_FP
 	assert(0 && "FP type is disabled");
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -1055,7 +1247,6 @@ void __CrownDouble2(double* x, double val, int cnt_sym_var, int ln, char* fname,
 #ifdef DISABLE_FP
     assert(0 && "FP type is disabled");
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -1078,7 +1269,6 @@ void __CrownLongDouble(long double* x, int cnt_sym_var, int ln, char* fname, ...
 #ifdef DISABLE_FP
 	assert(0 && "FP type is disabled");
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -1102,7 +1292,6 @@ void __CrownLongDouble2(long double* x, long double val, int cnt_sym_var, int ln
 #ifdef DISABLE_FP
     assert(0 && "FP type is disabled");
 #endif
-    pre_symbolic = 0;
 
     std::stringstream sym_name;
     sym_name << var_name << "_" << cnt_sym_var;
@@ -1122,7 +1311,6 @@ void __CrownPointer(void ** x, value_t size, int cnt_sym_var, int ln, char* fnam
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -1158,7 +1346,6 @@ unsigned long long __CrownBitField(unsigned char* x, char unionSize, int lowestB
 #ifdef MALLOC_HOOK_ENABLED
 	restore_original_hooks();
 #endif
-	pre_symbolic = 0;
 
 	std::stringstream sym_name;	
 	sym_name << var_name << "_" << cnt_sym_var;
@@ -1212,27 +1399,21 @@ unsigned long long __CrownBitField(unsigned char* x, char unionSize, int lowestB
 	return 0;
 }
 
-void __CrownSetCallerCalleeName(__CROWN_ID id, char *caller_, char *callee_){
-    if (!enable_symbolic) return;
-    assert(caller_);
-    assert(callee_);
-    strncpy(caller, caller_, sizeof(caller));
-    strncpy(callee, callee_, sizeof(callee));
+void __CrownSetCallee(__CROWN_ID id, __CROWN_ADDR callee) {
+	expected_callee = callee;
 }
-void __CrownEnableSymbolic(__CROWN_ID id, char *caller_){
-    // XXX: Recursion may corrupt this feature
-    // especilly when the caller of disabler is 
-    // called recursively by the uninstrumented function.
-    if (strcmp(caller, caller_) == 0){
-        enable_symbolic = 1;
-    }
+
+void __CrownCheckSymbolic(__CROWN_ID id, __CROWN_FUNCTION_ID fid, __CROWN_ADDR self) {
+	Frame f;
+	f.fid = fid;
+	f.allowed = IsAllowed(fid);
+	// The outermost frame of a thread is main or the thread's start
+	// routine; any other frame not called directly is a callback.
+	f.callback = !frames.empty() && (expected_callee != self);
+	expected_callee = 0;
+
+	frames.push_back(f);
+	allowed_depth += f.allowed;
+	callback_depth += f.callback;
+	enable_symbolic = (callback_depth == 0);
 }
-void __CrownCheckSymbolic (__CROWN_ID id, char *callee_){
-    if (!enable_symbolic) return;
-    // Ignore main() func
-    // XXX: assume that main is not called recursively
-    if (strcmp(callee_, "main") == 0) return; 
-    if (strcmp(callee, callee_) != 0){
-        enable_symbolic = 0;
-    }
-}   
@@ -215,6 +215,8 @@ EXTERN void __CrownInit(__CROWN_ID) __SKIP;
 EXTERN void __CrownRegGlobal(__CROWN_ID, __CROWN_ADDR, unsigned long, __CROWN_TYPE) __SKIP;
 EXTERN void __CrownAlloc(__CROWN_ID, __CROWN_ADDR, unsigned long) __SKIP;
 EXTERN void __CrownFree(__CROWN_ID, __CROWN_ADDR) __SKIP;
+EXTERN void __CrownPtrApply2(__CROWN_ID, __CROWN_OP, unsigned long, __CROWN_VALUE) __SKIP;
+#ifndef __CROWN_INLINE
 EXTERN void __CrownLoad(__CROWN_ID, __CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
 EXTERN void __CrownDeref(__CROWN_ID, __CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
 EXTERN void __CrownStore(__CROWN_ID, __CROWN_ADDR) __SKIP;
@@ -222,14 +224,153 @@ EXTERN void __CrownWrite(__CROWN_ID, __CROWN_ADDR) __SKIP;
 EXTERN void __CrownClearStack(__CROWN_ID) __SKIP;
 EXTERN void __CrownApply1(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
 EXTERN void __CrownApply2(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
-EXTERN void __CrownPtrApply2(__CROWN_ID, __CROWN_OP, unsigned long, __CROWN_VALUE) __SKIP;
+/* Fused: two Loads and an Apply2, and an Apply2 comparison and a Branch. */
+EXTERN void __CrownLoad2Apply2(__CROWN_ID,
+		__CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE,
+		__CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE,
+		__CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
+EXTERN void __CrownCompareBranch(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_BRANCH_ID, __CROWN_BOOL, __CROWN_LINE_NO, __CROWN_FILE_NAME) __SKIP;
 EXTERN void __CrownBranch(__CROWN_ID, __CROWN_BRANCH_ID, __CROWN_BOOL, __CROWN_LINE_NO, __CROWN_FILE_NAME, __CROWN_EXP) __SKIP;
 EXTERN void __CrownCall(__CROWN_ID, __CROWN_FUNCTION_ID) __SKIP;
 EXTERN void __CrownReturn(__CROWN_ID) __SKIP;
 EXTERN void __CrownHandleReturn(__CROWN_ID,  __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
-EXTERN void __CrownSetCallerCalleeName(__CROWN_ID, char *caller, char *callee) __SKIP;
-EXTERN void __CrownEnableSymbolic(__CROWN_ID, char *caller) __SKIP;
-EXTERN void __CrownCheckSymbolic(__CROWN_ID, char *callee) __SKIP;
+#endif
+/*
+ * Symbolic regions: __CrownSetCallee precedes each direct call, and
+ * __CrownCheckSymbolic is the first callback of each function.
+ */
+EXTERN void __CrownSetCallee(__CROWN_ID, __CROWN_ADDR callee) __SKIP;
+EXTERN void __CrownCheckSymbolic(__CROWN_ID, __CROWN_FUNCTION_ID, __CROWN_ADDR self) __SKIP;
+
+
+/*
+ * Inline fast paths.
+ *
+ * libcrown keeps __CrownState up to date: __CROWN_STATE_ENABLED is set
+ * by __CrownInit, and __CROWN_STATE_TRACING while symbolic expressions
+ * are built (i.e., not in branch-only mode).  Whether symbolic
+ * execution is disabled inside an un-instrumented callee (see
+ * __CrownCheckSymbolic) is per thread, and is still checked by
+ * libcrown.  When the program is compiled with __CROWN_INLINE (crownc
+ * does this), the hot callbacks above are static inline wrappers that
+ * test the state word and only call into libcrown when the callback
+ * would do something.  The __Crown*Slow entry points are the
+ * out-of-line callbacks themselves.
+ */
+#define __CROWN_STATE_ENABLED 0x1
+#define __CROWN_STATE_TRACING 0x2
+
+EXTERN int __CrownState;
+
+EXTERN void __CrownLoadSlow(__CROWN_ID, __CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
+EXTERN void __CrownDerefSlow(__CROWN_ID, __CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
+EXTERN void __CrownStoreSlow(__CROWN_ID, __CROWN_ADDR) __SKIP;
+EXTERN void __CrownWriteSlow(__CROWN_ID, __CROWN_ADDR) __SKIP;
+EXTERN void __CrownClearStackSlow(__CROWN_ID) __SKIP;
+EXTERN void __CrownApply1Slow(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
+EXTERN void __CrownApply2Slow(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
+EXTERN void __CrownLoad2Apply2Slow(__CROWN_ID,
+		__CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE,
+		__CROWN_ADDR, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE,
+		__CROWN_OP, __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
+EXTERN void __CrownCompareBranchSlow(__CROWN_ID, __CROWN_OP, __CROWN_TYPE, __CROWN_BRANCH_ID, __CROWN_BOOL, __CROWN_LINE_NO, __CROWN_FILE_NAME) __SKIP;
+EXTERN void __CrownBranchSlow(__CROWN_ID, __CROWN_BRANCH_ID, __CROWN_BOOL, __CROWN_LINE_NO, __CROWN_FILE_NAME, __CROWN_EXP) __SKIP;
+EXTERN void __CrownCallSlow(__CROWN_ID, __CROWN_FUNCTION_ID) __SKIP;
+EXTERN void __CrownReturnSlow(__CROWN_ID) __SKIP;
+EXTERN void __CrownHandleReturnSlow(__CROWN_ID,  __CROWN_TYPE, __CROWN_VALUE, __CROWN_FP_VALUE) __SKIP;
+
+#ifdef __CROWN_INLINE
+/*
+ * "used" keeps CIL from removing the wrappers before the instrumentation
+ * pass inserts the calls to them.  The wrappers take the arguments the
+ * instrumentation passes (e.g., no expression string for Branch).
+ */
+#define __CROWN_FAST static inline __attribute__((used, crown_skip))
+
+#define __CROWN_TRACING (__CrownState & __CROWN_STATE_TRACING)
+#define __CROWN_ENABLED (__CrownState & __CROWN_STATE_ENABLED)
+
+__CROWN_FAST void __CrownLoad(__CROWN_ID id, __CROWN_ADDR addr,
+		__CROWN_TYPE ty, __CROWN_VALUE val, __CROWN_FP_VALUE fp_val) {
+	if (__CROWN_TRACING)
+		__CrownLoadSlow(id, addr, ty, val, fp_val);
+}
+
+__CROWN_FAST void __CrownDeref(__CROWN_ID id, __CROWN_ADDR addr,
+		__CROWN_TYPE ty, __CROWN_VALUE val, __CROWN_FP_VALUE fp_val) {
+	if (__CROWN_TRACING)
+		__CrownDerefSlow(id, addr, ty, val, fp_val);
+}
+
+__CROWN_FAST void __CrownStore(__CROWN_ID id, __CROWN_ADDR addr) {
+	if (__CROWN_TRACING)
+		__CrownStoreSlow(id, addr);
+}
+
+__CROWN_FAST void __CrownWrite(__CROWN_ID id, __CROWN_ADDR addr) {
+	if (__CROWN_TRACING)
+		__CrownWriteSlow(id, addr);
+}
+
+__CROWN_FAST void __CrownClearStack(__CROWN_ID id) {
+	if (__CROWN_TRACING)
+		__CrownClearStackSlow(id);
+}
+
+__CROWN_FAST void __CrownApply1(__CROWN_ID id, __CROWN_OP op,
+		__CROWN_TYPE ty, __CROWN_VALUE val, __CROWN_FP_VALUE fp_val) {
+	if (__CROWN_TRACING)
+		__CrownApply1Slow(id, op, ty, val, fp_val);
+}
+
+__CROWN_FAST void __CrownApply2(__CROWN_ID id, __CROWN_OP op,
+		__CROWN_TYPE ty, __CROWN_VALUE val, __CROWN_FP_VALUE fp_val) {
+	if (__CROWN_TRACING)
+		__CrownApply2Slow(id, op, ty, val, fp_val);
+}
+
+__CROWN_FAST void __CrownLoad2Apply2(__CROWN_ID id,
+		__CROWN_ADDR addr1, __CROWN_TYPE ty1, __CROWN_VALUE val1, __CROWN_FP_VALUE fp_val1,
+		__CROWN_ADDR addr2, __CROWN_TYPE ty2, __CROWN_VALUE val2, __CROWN_FP_VALUE fp_val2,
+		__CROWN_OP op, __CROWN_TYPE ty, __CROWN_VALUE val, __CROWN_FP_VALUE fp_val) {
+	if (__CROWN_TRACING)
+		__CrownLoad2Apply2Slow(id, addr1, ty1, val1, fp_val1,
+				addr2, ty2, val2, fp_val2, op, ty, val, fp_val);
+}
+
+/* Branches are recorded even before the first input is read. */
+__CROWN_FAST void __CrownCompareBranch(__CROWN_ID id, __CROWN_OP op, __CROWN_TYPE ty,
+		__CROWN_BRANCH_ID bid, __CROWN_BOOL b, __CROWN_LINE_NO l, __CROWN_FILE_NAME f) {
+	if (__CROWN_ENABLED)
+		__CrownCompareBranchSlow(id, op, ty, bid, b, l, f);
+}
+
+__CROWN_FAST void __CrownBranch(__CROWN_ID id, __CROWN_BRANCH_ID bid,
+		__CROWN_BOOL b, __CROWN_LINE_NO l, __CROWN_FILE_NAME f) {
+	if (__CROWN_ENABLED)
+		__CrownBranchSlow(id, bid, b, l, f, 0);
+}
+
+__CROWN_FAST void __CrownCall(__CROWN_ID id, __CROWN_FUNCTION_ID fid) {
+	if (__CROWN_ENABLED)
+		__CrownCallSlow(id, fid);
+}
+
+__CROWN_FAST void __CrownReturn(__CROWN_ID id) {
+	if (__CROWN_ENABLED)
+		__CrownReturnSlow(id);
+}
+
+__CROWN_FAST void __CrownHandleReturn(__CROWN_ID id, __CROWN_TYPE ty,
+		__CROWN_VALUE val, __CROWN_FP_VALUE fp_val) {
+	if (__CROWN_TRACING)
+		__CrownHandleReturnSlow(id, ty, val, fp_val);
+}
+
+#undef __CROWN_TRACING
+#undef __CROWN_ENABLED
+#undef __CROWN_FAST
+#endif  /* __CROWN_INLINE */
 
 /*
  * Functions (macros) for obtaining symbolic inputs.
@@ -32,16 +32,19 @@ void Logger::DumpMemElem(const SymbolicMemoryWriter::MemElem &elem, const addr_t
 	}
 }
 void Logger::DumpSymbolicMemoryWriter(const SymbolicMemoryWriter &sym_mem) {
-	hash_map<addr_t,SymbolicMemoryWriter::MemElem>::const_iterator it;
-	for (it = sym_mem.mem_.begin(); it != sym_mem.mem_.end(); ++it) {
-		DumpMemElem(it->second, it->first);
+	if (!sym_mem.mem_)
+		return;
+	SymbolicMemoryWriter::PageMap::const_iterator it;
+	for (it = sym_mem.mem_->begin(); it != sym_mem.mem_->end(); ++it) {
+		DumpMemElem(*it->second, it->first);
 	}
 }
 
-void Logger::DumpMemoryAndStack(const SymbolicMemoryWriter &mem_, 
-		const vector<SymbolicInterpreter::StackElem> &stack_) {
+void Logger::DumpMemoryAndStack(const ShardedMemoryWriter &mem_, 
+		const SymbolicInterpreter::Stack &stack_) {
 	fprintf(stderr, "\n");
-	DumpSymbolicMemoryWriter(mem_);
+	for (size_t i = 0; i < ShardedMemoryWriter::kNumShards; i++)
+		DumpSymbolicMemoryWriter(mem_.shards_[i].mem);
 
 	for (size_t i = 0; i < stack_.size(); i++) {
 		string s,fp_s;
@@ -16,8 +16,8 @@ namespace crown{
 
 class Logger{
 public:
-	static void DumpMemoryAndStack(const SymbolicMemoryWriter &,
-			const vector<SymbolicInterpreter::StackElem>&);
+	static void DumpMemoryAndStack(const ShardedMemoryWriter &,
+			const SymbolicInterpreter::Stack&);
 	static void DumpSymbolicMemoryWriter(const SymbolicMemoryWriter&);
 	static void DumpMemElem(const SymbolicMemoryWriter::MemElem&, const addr_t);
 
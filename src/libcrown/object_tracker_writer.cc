@@ -142,8 +142,18 @@ void ObjectTrackerWriter::Serialize(ostream &os) const {
 		size_t objsSize = snapshotManager_[i]->size();
 
 		os.write((char*)&objsSize, sizeof(size_t));
+		// Each snapshot is preceded by its length, so that the reader
+		// can skip it until a dereference needs it.
 		for(size_t j = 0; j < objsSize; j++){
+			size_t len = 0;
+			std::streampos at = os.tellp();
+			os.write((char*)&len, sizeof(len));
 			snapshotManager_[i]->at(j)->Serialize(os);
+			std::streampos end = os.tellp();
+			len = end - at - (std::streamoff)sizeof(len);
+			os.seekp(at);
+			os.write((char*)&len, sizeof(len));
+			os.seekp(end);
 		}
 	}
 
@@ -53,6 +53,12 @@ void SymbolicExecutionWriter::Serialize(ostream &os, const ObjectTrackerWriter*
 	size_t len = vars_.size();
 	size_t name_len;
 
+	// Reserve the header; the section offsets are patched in at the end.
+	ExecutionHeader header;
+	std::streampos start = os.tellp();
+	os.write((char*)&header, sizeof(header));
+
+	header.inputs_offset = os.tellp() - start;
 	os.write((char*)&len, sizeof(len));
 	for (VarIt i = vars_.begin(); i != vars_.end(); ++i) {
         //i->first means index of variable.
@@ -88,11 +94,21 @@ void SymbolicExecutionWriter::Serialize(ostream &os, const ObjectTrackerWriter*
 
 	}
 	// Write symbolic objects from snapshotManager_
+	header.tracker_offset = os.tellp() - start;
 	tracker->Serialize(os);	
 
 	// Write the path.
-	path_.Serialize(os);
-
+	header.branches_offset = os.tellp() - start;
+	path_.SerializeBranches(os);
+	header.constraints_offset = os.tellp() - start;
+	path_.SerializeConstraints(os);
+	header.hits_offset = os.tellp() - start;
+	path_.SerializeHits(os);
+
+	std::streampos end = os.tellp();
+	os.seekp(start);
+	os.write((char*)&header, sizeof(header));
+	os.seekp(end);
 
 }
 
@@ -14,6 +14,36 @@
 
 namespace crown{
 
+namespace {
+
+bool IsIntegralType(type_t ty) {
+	return ((types::U_CHAR <= ty && ty <= types::LONG_LONG)
+			|| ty == types::POINTER);
+}
+
+// An integer bit-vector operand (not a comparison result).
+bool IsIntegralExpr(const SymbolicExprWriter* e) {
+	if (!IsIntegralType(e->value().type) || e->CastPredExprWriter())
+		return false;
+	const UnaryExprWriter* u = e->CastUnaryExprWriter();
+	return (u == NULL || u->unary_op() != ops::LOGICAL_NOT);
+}
+
+bool IsConstant(const SymbolicExprWriter* e, value_t c) {
+	return (e->IsConcrete() && IsIntegralType(e->value().type)
+			&& e->value().integral == c);
+}
+
+bool IsAllOnes(const SymbolicExprWriter* e, size_t size) {
+	if (!e->IsConcrete() || !IsIntegralType(e->value().type))
+		return false;
+	unsigned long long mask = (size >= sizeof(mask))
+		? ~0ULL : ((1ULL << (8*size)) - 1);
+	return ((e->value().integral & mask) == mask);
+}
+
+}  // namespace
+
 SymbolicExprWriter* SymbolicExprWriterFactory::NewConcreteExpr(Value_t val) {
 #ifdef DEBUG
 	std::cerr<<"Concrete: "<<val.integral<<" "<<val.floating<<"\n";
@@ -31,19 +61,75 @@ SymbolicExprWriter* SymbolicExprWriterFactory::NewConcreteExpr(size_t size, Valu
 
 SymbolicExprWriter* SymbolicExprWriterFactory::NewUnaryExprWriter(Value_t val,
 		ops::unary_op_t op, SymbolicExprWriter* e) {
+	// A cast to the operand's own type leaves it as is.  (A cast between
+	// types of the same width keeps the bits, but not the signedness the
+	// readers see in value().type.)
+	if ((op == ops::SIGNED_CAST || op == ops::UNSIGNED_CAST)
+			&& IsIntegralType(val.type) && IsIntegralExpr(e)
+			&& e->value().type == val.type
+			&& e->size() == kSizeOfType[val.type]) {
+		return e;
+	}
 	return new UnaryExprWriter(op, e, kSizeOfType[val.type], val);
 }
 
 SymbolicExprWriter* SymbolicExprWriterFactory::NewBinExprWriter(Value_t val,
 		ops::binary_op_t op,
 		SymbolicExprWriter* e1, SymbolicExprWriter* e2) {
+	if (IsIntegralType(val.type) && IsIntegralExpr(e1) && IsIntegralExpr(e2)) {
+		size_t size = kSizeOfType[val.type];
+		SymbolicExprWriter* keep = NULL;
+		SymbolicExprWriter* drop = NULL;
+
+		switch (op) {
+			case ops::ADD:
+			case ops::BITWISE_OR:
+			case ops::BITWISE_XOR:
+				// x + 0, x | 0, x ^ 0 (either side)
+				if (IsConstant(e2, 0)) { keep = e1; drop = e2; }
+				else if (IsConstant(e1, 0)) { keep = e2; drop = e1; }
+				break;
+			case ops::SUBTRACT:
+			case ops::SHIFT_L:
+			case ops::SHIFT_R:
+			case ops::S_SHIFT_R:
+				// x - 0, x << 0, x >> 0
+				if (IsConstant(e2, 0)) { keep = e1; drop = e2; }
+				break;
+			case ops::MULTIPLY:
+				// x * 1 (either side)
+				if (IsConstant(e2, 1)) { keep = e1; drop = e2; }
+				else if (IsConstant(e1, 1)) { keep = e2; drop = e1; }
+				break;
+			case ops::DIV:
+			case ops::S_DIV:
+				// x / 1
+				if (IsConstant(e2, 1)) { keep = e1; drop = e2; }
+				break;
+			case ops::BITWISE_AND:
+				// x & ~0 (either side)
+				if (IsAllOnes(e2, size)) { keep = e1; drop = e2; }
+				else if (IsAllOnes(e1, size)) { keep = e2; drop = e1; }
+				break;
+			default:
+				break;
+		}
+
+		// Only valid if no extension to the result width is needed, and
+		// the kept operand already has the result's type (signedness).
+		if (keep != NULL && keep->size() == size
+				&& keep->value().type == val.type) {
+			delete drop;
+			return keep;
+		}
+	}
 	return new BinExprWriter(op, e1, e2, kSizeOfType[val.type], val);
 }
 
 SymbolicExprWriter* SymbolicExprWriterFactory::NewBinExprWriter(Value_t val,
 		ops::binary_op_t op,
 		SymbolicExprWriter* e1, Value_t e2) {
-	return new BinExprWriter(op, e1, NewConcreteExpr(e2), kSizeOfType[val.type], val);
+	return NewBinExprWriter(val, op, e1, NewConcreteExpr(e2));
 }
 
 
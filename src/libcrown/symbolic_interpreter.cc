@@ -41,26 +41,85 @@ using std::string;
 namespace crown {
 
 typedef map<addr_t,SymbolicExprWriter*>::const_iterator ConstMemIt;
+typedef std::lock_guard<std::mutex> Lock;
+
+thread_local SymbolicInterpreter::Stack SymbolicInterpreter::stack_;
+thread_local bool SymbolicInterpreter::return_value_;
+thread_local SymbolicInterpreter::ThreadTrace* SymbolicInterpreter::trace_ = NULL;
+thread_local size_t SymbolicInterpreter::context_ = 0;
+thread_local vector<size_t> SymbolicInterpreter::contexts_;
 
 SymbolicInterpreter::SymbolicInterpreter()
-	: ex_(true), num_inputs_(0) {
-	  stack_.reserve(16);
+	: site_budget_(0), next_seq_(0), num_inputs_(0) {
+	InitTrackerLock();
 }
 
 SymbolicInterpreter::SymbolicInterpreter(
-		const vector<Value_t>& input) : ex_(true) {
-	stack_.reserve(16);
+		const vector<Value_t>& input) : site_budget_(0), next_seq_(0) {
+	InitTrackerLock();
 	num_inputs_ = 0;
 	ex_.mutable_inputs()->assign(input.begin(), input.end());
 }
 
 
+void SymbolicInterpreter::InitTrackerLock() {
+	// Loads from untracked memory hold the lock shared all the time, so
+	// writers (Alloc, Free, accesses to tracked objects) must not wait
+	// for the readers to drain.
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr,
+			PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&tracker_lock_, &attr);
+	pthread_rwlockattr_destroy(&attr);
+}
+
+
+SymbolicInterpreter::TrackerLock::TrackerLock(SymbolicInterpreter* si,
+		bool exclusive) : lock_(&si->tracker_lock_), exclusive_(exclusive) {
+#ifndef DISABLE_DEREF
+	if (exclusive_)
+		pthread_rwlock_wrlock(lock_);
+	else
+		pthread_rwlock_rdlock(lock_);
+#endif
+}
+
+SymbolicInterpreter::TrackerLock::~TrackerLock() {
+#ifndef DISABLE_DEREF
+	pthread_rwlock_unlock(lock_);
+#endif
+}
+
+void SymbolicInterpreter::TrackerLock::Exclusive() {
+#ifndef DISABLE_DEREF
+	if (!exclusive_) {
+		pthread_rwlock_unlock(lock_);
+		pthread_rwlock_wrlock(lock_);
+		exclusive_ = true;
+	}
+#endif
+}
+
+
+// Returns the tracked object containing addr, or NULL.  If there is one,
+// lock is made exclusive first, so the object can be updated.
+SymbolicObjectWriter* SymbolicInterpreter::FindObject(addr_t addr,
+		TrackerLock* lock) {
+#ifdef DISABLE_DEREF
+	return NULL;  // No regions are ever tracked.
+#else
+	if (obj_tracker_.find(addr) == NULL)
+		return NULL;
+	lock->Exclusive();
+	// Looked up again: the region may have been freed in between.
+	return obj_tracker_.find(addr);
+#endif
+}
+
+
 void SymbolicInterpreter::ClearStack(id_t id) {
 	IFDEBUG(fprintf(stderr, "clear\n"));
-	vector<StackElem>::const_iterator it;
-	for (it = stack_.begin(); it != stack_.end(); ++it) {
-		//delete it->expr;
-	}
 	stack_.clear();
 	return_value_ = false;
 	IFDEBUG(Logger::DumpMemoryAndStack(mem_, stack_));
@@ -70,15 +129,7 @@ void SymbolicInterpreter::ClearStack(id_t id) {
 void SymbolicInterpreter::Load(id_t id, addr_t addr, Value_t value) {
 	IFDEBUG(fprintf(stderr, "load 0x%lx %lld\n", addr, value.integral));
 
-	SymbolicObjectWriter* obj = obj_tracker_.find(addr);
-	SymbolicExprWriter* e = NULL;
-	if(obj == NULL){
-		// Load from main memory.
-		e = mem_.read(addr, value);
-	}else{
-		e = obj->read(addr, value);
-		obj_tracker_.updateDereferredStateOfRegion(*obj, addr, true);
-	}
+	SymbolicExprWriter* e = ReadMemory(addr, value);
 
 	IFDEBUG2({
 	if (e) {
@@ -91,13 +142,28 @@ void SymbolicInterpreter::Load(id_t id, addr_t addr, Value_t value) {
 	IFDEBUG(Logger::DumpMemoryAndStack(mem_, stack_));
 }
 
+SymbolicExprWriter* SymbolicInterpreter::ReadMemory(addr_t addr, Value_t value) {
+	if (addr == 0)
+		return NULL;  // A constant.
+	TrackerLock lock(this);
+	SymbolicObjectWriter* obj = FindObject(addr, &lock);
+	if(obj == NULL){
+		// Load from main memory.
+		return mem_.read(addr, value);
+	}
+	SymbolicExprWriter* e = obj->read(addr, value);
+	obj_tracker_.updateDereferredStateOfRegion(*obj, addr, true);
+	return e;
+}
+
 void SymbolicInterpreter::Deref(id_t id, addr_t addr, Value_t value) {
 	IFDEBUG(fprintf(stderr, "deref %lu %lld\n", addr, value.integral));
 	assert(stack_.size() > 0);
 
 	SymbolicExprWriter* e = NULL;
+	TrackerLock lock(this);
 	// Find right sym_obj from obj_tracker (set of sym_obj) 
-	SymbolicObjectWriter* obj = obj_tracker_.find(addr);
+	SymbolicObjectWriter* obj = FindObject(addr, &lock);
 
 	const StackElem& se = stack_.back();
 	// Is this a symbolic dereference?
@@ -148,8 +214,9 @@ void SymbolicInterpreter::Store(id_t id, addr_t addr) {
 			fprintf(stderr, "store 0x%lx : %s\n", addr, s.c_str());
 		}})
 
+	TrackerLock lock(this);
 	// Is this a write to an object?
-	SymbolicObjectWriter* obj = obj_tracker_.find(addr);
+	SymbolicObjectWriter* obj = FindObject(addr, &lock);
 
 	if(obj == NULL){
 		// Write to untracked region/object.
@@ -190,7 +257,7 @@ void SymbolicInterpreter::Write(id_t id, addr_t addr) {
 	IFDEBUG(fprintf(stderr, "write 0x%lx id %d\n", addr,id));
 	assert(stack_.size() > 1);
 
-	const StackElem& dest = *(stack_.rbegin()+1);
+	const StackElem& dest = stack_[stack_.size() - 2];
 	const StackElem& val = stack_.back();
 
 	IFDEBUG2({
@@ -200,8 +267,9 @@ void SymbolicInterpreter::Write(id_t id, addr_t addr) {
 		fprintf(stderr, "store %lu : %s\n", addr, s.c_str());
 		}})
 
+	TrackerLock lock(this);
 	// Is this a write to an object.
-	SymbolicObjectWriter* obj = obj_tracker_.find(addr);
+	SymbolicObjectWriter* obj = FindObject(addr, &lock);
 
 	if (obj == NULL) {
 		// Normal store -- may be concretizing a symbolic write to an
@@ -259,7 +327,7 @@ void SymbolicInterpreter::ApplyBinaryOp(id_t id, binary_op_t op,
 		Value_t value) {
 	IFDEBUG(fprintf(stderr, "apply2 %d %lld\n", op, value.integral));
 	assert(stack_.size() >= 2);
-	StackElem& a = *(stack_.rbegin()+1);
+	StackElem& a = stack_[stack_.size() - 2];
 	StackElem& b = stack_.back();
 
 	if (a.expr) {
@@ -316,7 +384,7 @@ void SymbolicInterpreter::ApplyBinPtrOp(id_t id, pointer_op_t op,
 										size_t size, value_t value) {
 	IFDEBUG(fprintf(stderr, "apply2ptr %d(%zu) %lld\n", op, size, value));
 	assert(stack_.size() >= 2);
-	StackElem& a = *(stack_.rbegin()+1);
+	StackElem& a = stack_[stack_.size() - 2];
 	StackElem& b = stack_.back();
 
 	type_t ty = (op == ops::SUBTRACT_PP) ? types::LONG : types::U_LONG;
@@ -369,7 +437,7 @@ void SymbolicInterpreter::ApplyCompareOp(id_t id, compare_op_t op,
 		Value_t value) {
 	IFDEBUG(fprintf(stderr, "compare2 %d %lld\n", op, value.integral));
 	assert(stack_.size() >= 2);
-	StackElem& a = *(stack_.rbegin()+1);
+	StackElem& a = stack_[stack_.size() - 2];
 	StackElem& b = stack_.back();
 
 	if (a.expr) {
@@ -390,13 +458,61 @@ void SymbolicInterpreter::ApplyCompareOp(id_t id, compare_op_t op,
 }
 
 
+void SymbolicInterpreter::LoadApplyBinaryOp(id_t id, addr_t addr1, Value_t value1,
+		addr_t addr2, Value_t value2, binary_op_t op, Value_t value) {
+	IFDEBUG(fprintf(stderr, "load2 apply2 0x%lx 0x%lx %d %lld\n",
+				addr1, addr2, op, value.integral));
+	SymbolicExprWriter* a = ReadMemory(addr1, value1);
+	SymbolicExprWriter* b = ReadMemory(addr2, value2);
+	SymbolicExprWriter* e = NULL;
+	if ((a || b) && (op != ops::CONCRETE)) {
+		if (a == NULL)
+			a = SymbolicExprWriterFactory::NewConcreteExpr(value1);
+		if (b == NULL)
+			b = SymbolicExprWriterFactory::NewConcreteExpr(value2);
+		e = SymbolicExprWriterFactory::NewBinExprWriter(value, op, a, b);
+	} else {
+		delete a;
+		delete b;
+	}
+	PushSymbolic(e, value);
+	IFDEBUG(Logger::DumpMemoryAndStack(mem_, stack_));
+}
+
+void SymbolicInterpreter::LoadApplyCompareOp(id_t id, addr_t addr1, Value_t value1,
+		addr_t addr2, Value_t value2, compare_op_t op, Value_t value) {
+	IFDEBUG(fprintf(stderr, "load2 compare2 0x%lx 0x%lx %d %lld\n",
+				addr1, addr2, op, value.integral));
+	SymbolicExprWriter* a = ReadMemory(addr1, value1);
+	SymbolicExprWriter* b = ReadMemory(addr2, value2);
+	SymbolicExprWriter* e = NULL;
+	if (a || b) {
+		if (a == NULL)
+			a = SymbolicExprWriterFactory::NewConcreteExpr(value1);
+		if (b == NULL)
+			b = SymbolicExprWriterFactory::NewConcreteExpr(value2);
+		e = SymbolicExprWriterFactory::NewPredExprWriter(value, op, a, b);
+	}
+	PushSymbolic(e, value);
+	IFDEBUG(Logger::DumpMemoryAndStack(mem_, stack_));
+}
+
+
 void SymbolicInterpreter::Call(id_t id, function_id_t fid) {
-	ex_.mutable_path()->Push(kCallId);
+	TracePath()->Push(kCallId);
+	if (site_budget_) {
+		contexts_.push_back(context_);
+		context_ = context_ * 31 + fid + 1;
+	}
 }
 
 
 void SymbolicInterpreter::Return(id_t id) {
-	ex_.mutable_path()->Push(kReturnId);
+	TracePath()->Push(kReturnId);
+	if (site_budget_ && !contexts_.empty()) {
+		context_ = contexts_.back();
+		contexts_.pop_back();
+	}
 
 	// There is either exactly one value on the stack -- the current function's
 	// return value -- or the stack is empty.
@@ -425,6 +541,9 @@ void SymbolicInterpreter::HandleReturn(id_t id, Value_t value) {
 void SymbolicInterpreter::Branch(id_t id, branch_id_t bid, bool pred_value,
 			unsigned int lineno, const char *filename, const char *exp) {
 	IFDEBUG(fprintf(stderr, "branch %d %d\n", bid, pred_value));
+	// Conditions the instrumentation proved concrete are not pushed.
+	if (stack_.empty())
+		PushConcrete(Value_t(pred_value, pred_value, types::CHAR));
 	assert(stack_.size() == 1);
 	StackElem& se = stack_.back();
 
@@ -452,7 +571,8 @@ void SymbolicInterpreter::Branch(id_t id, branch_id_t bid, bool pred_value,
 		}
 	}
 
-	ex_.mutable_path()->Push(bid, se.expr, pred_value, lineno, filename, exp);
+	TracePath()->Push(bid, se.expr, pred_value, lineno, filename, exp,
+			context_ * 0x9e3779b97f4a7c15ULL + bid);
 
 	stack_.pop_back();
 	IFDEBUG(Logger::DumpMemoryAndStack(mem_, stack_));
@@ -461,21 +581,68 @@ void SymbolicInterpreter::Branch(id_t id, branch_id_t bid, bool pred_value,
 void SymbolicInterpreter::Alloc(id_t id, addr_t addr, size_t size) {
 	//printf("id: %d\n",(int)id);
 #ifndef DISABLE_DEREF
+	TrackerLock lock(this, true);
 	obj_tracker_.addRegion(addr, size);
 #endif
 }
 
 void SymbolicInterpreter::Free(id_t id, addr_t addr) {
 #ifndef DISABLE_DEREF
+	TrackerLock lock(this, true);
 	obj_tracker_.storeObj(addr);
 	obj_tracker_.removeTrackingObj(addr);
 #endif
 }
 
 void SymbolicInterpreter::Exit() {
+	TrackerLock lock(this, true);
 #ifndef DISABLE_DEREF
 	obj_tracker_.storeAllObjAndRemove();
 #endif
+	MergeTraces();
+}
+
+
+SymbolicPathWriter* SymbolicInterpreter::TracePath() {
+	if (trace_ == NULL)
+		trace_ = NewThreadTrace();
+	trace_->seq.push_back(next_seq_++);
+	return &trace_->path;
+}
+
+
+SymbolicInterpreter::ThreadTrace* SymbolicInterpreter::NewThreadTrace() {
+	Lock lock(traces_lock_);
+	// Only the first (usually the main) thread's trace is pre-allocated.
+	traces_.push_back(new ThreadTrace(traces_.empty()));
+	traces_.back()->path.set_site_budget(site_budget_);
+	return traces_.back();
+}
+
+
+void SymbolicInterpreter::MergeTraces() {
+	Lock lock(traces_lock_);
+	SymbolicPathWriter* path = ex_.mutable_path();
+	for (size_t i = 0; i < traces_.size(); i++)
+		traces_[i]->path.Compact();
+	if (traces_.size() == 1) {
+		path->Swap(traces_[0]->path);
+		return;
+	}
+
+	vector<size_t> next(traces_.size(), 0), next_constraint(traces_.size(), 0);
+	for (;;) {
+		size_t t = traces_.size();
+		for (size_t i = 0; i < traces_.size(); i++) {
+			if ((next[i] < traces_[i]->seq.size())
+					&& ((t == traces_.size())
+						|| (traces_[i]->seq[next[i]] < traces_[t]->seq[next[t]])))
+				t = i;
+		}
+		if (t == traces_.size())
+			break;
+		path->MoveBranchFrom(&traces_[t]->path, next[t]++, &next_constraint[t]);
+	}
 }
 
 /*
@@ -486,6 +653,7 @@ void SymbolicInterpreter::Exit() {
 
 Value_t SymbolicInterpreter::NewInput(type_t ty, addr_t addr, char* var_name, int line, char* fname, unsigned long long oldValue, unsigned char h, unsigned char l, unsigned char indexSize) {
 	assert(ty != types::STRUCT);
+	Lock lock(inputs_lock_);
 	ex_.mutable_vars()->insert(make_pair(num_inputs_, ty));
   ex_.mutable_var_names()->push_back(string(var_name));
   ex_.mutable_locations()->push_back(Loc_t(string(fname),line));
@@ -529,7 +697,8 @@ Value_t SymbolicInterpreter::NewInput(type_t ty, addr_t addr, char* var_name, in
 
     // To handle old value of bitfield inputs
 
-    SymbolicObjectWriter* obj = obj_tracker_.find(addr);
+    TrackerLock tracker_lock(this);
+    SymbolicObjectWriter* obj = FindObject(addr, &tracker_lock);
     SymbolicExprWriter* e = NULL;
     if(obj == NULL){
         // Load from main memory.
@@ -562,6 +731,7 @@ Value_t SymbolicInterpreter::NewInput(type_t ty, addr_t addr, char* var_name, in
 
 Value_t SymbolicInterpreter::NewInput2(type_t ty, addr_t addr, Value_t init_val, char* var_name, int line, char* fname, unsigned long long oldValue, unsigned char h, unsigned char l, unsigned char indexSize) {
     assert(ty != types::STRUCT);
+    Lock lock(inputs_lock_);
     ex_.mutable_vars()->insert(make_pair(num_inputs_, ty));
   ex_.mutable_var_names()->push_back(string(var_name));
   ex_.mutable_locations()->push_back(Loc_t(string(fname),line));
@@ -604,7 +774,8 @@ Value_t SymbolicInterpreter::NewInput2(type_t ty, addr_t addr, Value_t init_val,
 
     // To handle old value of bitfield inputs
 
-    SymbolicObjectWriter* obj = obj_tracker_.find(addr);
+    TrackerLock tracker_lock(this);
+    SymbolicObjectWriter* obj = FindObject(addr, &tracker_lock);
     SymbolicExprWriter* e = NULL;
     if(obj == NULL){
         // Load from main memory.
@@ -643,8 +814,7 @@ void SymbolicInterpreter::PushConcrete(Value_t value) {
 void SymbolicInterpreter::PushSymbolic(SymbolicExprWriter* expr,
 		Value_t value) {
 	IFDEBUG(std::cerr<<"PushSymbolic: "<<value.integral<<" "<<value.floating<<"\n");
-	stack_.push_back(StackElem());
-	StackElem& se = stack_.back();
+	StackElem& se = stack_.push();
 	se.expr = expr;
 	se.ty = value.type;
 	se.concrete = value.integral;
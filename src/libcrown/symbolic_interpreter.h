@@ -11,10 +11,14 @@
 #ifndef BASE_SYMBOLIC_INTERPRETER_H__
 #define BASE_SYMBOLIC_INTERPRETER_H__
 
+#include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 
+#include <atomic>
 #include <ext/hash_map>
 #include <map>
+#include <mutex>
 #include <vector>
 
 #include "base/basic_types.h"
@@ -46,6 +50,12 @@ public:
 	void ApplyBinPtrOp(id_t id, pointer_op_t op, size_t size, value_t addr);
 	void ApplyCompareOp(id_t id, compare_op_t op, Value_t value);
 
+	// Fused forms of two Loads followed by ApplyBinaryOp/ApplyCompareOp.
+	void LoadApplyBinaryOp(id_t id, addr_t addr1, Value_t value1,
+			addr_t addr2, Value_t value2, binary_op_t op, Value_t value);
+	void LoadApplyCompareOp(id_t id, addr_t addr1, Value_t value1,
+			addr_t addr2, Value_t value2, compare_op_t op, Value_t value);
+
 	void Call(id_t id, function_id_t fid);
 	void Return(id_t id);
 	void HandleReturn(id_t id, Value_t value);
@@ -64,7 +74,13 @@ public:
      * received information is saved in symbolic execution writer.
      */
 
-	// Accessor for symbolic execution so far.
+	// Per-site constraint budget of the branch traces (see
+	// SymbolicPathWriter::set_site_budget).  A site is a branch id in a
+	// calling context.
+	void set_site_budget(size_t budget) { site_budget_ = budget; }
+
+	// Accessor for symbolic execution so far.  The branch traces of the
+	// threads are only merged into it by Exit.
 	const SymbolicExecutionWriter& execution() const { return ex_; }
 	const ObjectTrackerWriter* tracker() const { return &obj_tracker_; }
 
@@ -76,17 +92,93 @@ private:
 		type_t ty;
 	};
 
+	// Fixed-capacity stack, stored inline (no heap).  The instrumentation
+	// pushes at most the operands of one expression or the arguments of
+	// one call before popping them, so a small bound suffices.  Overflow
+	// is only checked in DEBUG builds.
+	class alignas(64) Stack {
+	public:
+		static const size_t kCapacity = 128;
+
+		Stack() : size_(0) { }
+
+		size_t size() const { return size_; }
+		bool empty() const { return (size_ == 0); }
+		void clear() { size_ = 0; }
+
+		// Returns the new, uninitialized top element.
+		StackElem& push() {
+#ifdef DEBUG
+			assert(size_ < kCapacity);
+#endif
+			return elems_[size_++];
+		}
+		void pop_back() {
+#ifdef DEBUG
+			assert(size_ > 0);
+#endif
+			size_--;
+		}
+
+		StackElem& back() { return elems_[size_ - 1]; }
+		StackElem& operator[](size_t i) { return elems_[i]; }
+		const StackElem& operator[](size_t i) const { return elems_[i]; }
+
+	private:
+		StackElem elems_[kCapacity];
+		size_t size_;
+	};
+
+	// Branches taken by one thread, each stamped with a global sequence
+	// number so the traces can be merged in execution order.
+	struct ThreadTrace {
+		explicit ThreadTrace(bool pre_allocate) : path(pre_allocate) { }
+		SymbolicPathWriter path;
+		vector<unsigned long long> seq;
+	};
+
+	// Holds tracker_lock_, shared until Exclusive() is called.  Without
+	// object tracking (DISABLE_DEREF) it does nothing.
+	class TrackerLock {
+	public:
+		explicit TrackerLock(SymbolicInterpreter* si, bool exclusive = false);
+		~TrackerLock();
+		void Exclusive();
+	private:
+		pthread_rwlock_t* lock_;
+		bool exclusive_;
+	};
+
+	// Guards obj_tracker_ and the tracked objects: held shared to look up
+	// an address, and exclusively to change them.  Memory outside the
+	// tracked objects has its own locks (see ShardedMemoryWriter).
+	pthread_rwlock_t tracker_lock_;
+
+	// Guards the inputs of ex_ and num_inputs_.
+	std::mutex inputs_lock_;
+
 	//Symbolic object
 	ObjectTrackerWriter obj_tracker_;
 
-	// Stack.
-	vector<StackElem> stack_;
+	// Stack (per thread).
+	static thread_local Stack stack_;
 
 	// Symbolic Memory.
-	SymbolicMemoryWriter mem_;
+	ShardedMemoryWriter mem_;
+
+	// Is the top of the stack a function return value?  (Per thread.)
+	static thread_local bool return_value_;
+
+	// Branch trace of the current thread, and of all threads.
+	static thread_local ThreadTrace* trace_;
+	size_t site_budget_;
 
-	// Is the top of the stack a function return value?
-	bool return_value_;
+	// Hash of the current thread's call stack, and of its callers.
+	static thread_local size_t context_;
+	static thread_local vector<size_t> contexts_;
+	std::mutex traces_lock_;
+	vector<ThreadTrace*> traces_;
+	std::atomic<unsigned long long> next_seq_;
 
 	// The symbolic execution (program path and inputs).
 	SymbolicExecutionWriter ex_;
@@ -95,6 +187,12 @@ private:
 	unsigned int num_inputs_;
 
 	// Helper functions.
+	void InitTrackerLock();
+	inline SymbolicObjectWriter* FindObject(addr_t addr, TrackerLock* lock);
+	inline SymbolicExprWriter* ReadMemory(addr_t addr, Value_t value);
+	inline SymbolicPathWriter* TracePath();
+	ThreadTrace* NewThreadTrace();
+	void MergeTraces();
 	inline void PushConcrete(Value_t value);
 	inline void PushSymbolic(SymbolicExprWriter* expr, Value_t value);
 	inline void ClearPredicateRegister();
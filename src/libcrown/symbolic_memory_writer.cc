@@ -12,6 +12,8 @@
 #include <utility>
 #include <assert.h>
 #include <cstdio>
+#include <new>
+#include <stdlib.h>
 #include "libcrown/symbolic_memory_writer.h"
 #include "libcrown/symbolic_expression_writer.h"
 #include "libcrown/symbolic_expression_factory.h"
@@ -198,41 +200,67 @@ SymbolicMemoryWriter::SymbolicMemoryWriter(const SymbolicMemoryWriter& m)
 SymbolicMemoryWriter::~SymbolicMemoryWriter() { }
 
 void SymbolicMemoryWriter::Dump() const {
-	hash_map<addr_t,MemElem>::const_iterator it;
-	for (it = mem_.begin(); it != mem_.end(); ++it) {
-		it->second.Dump(it->first);
+	if (!mem_)
+		return;
+	PageMap::const_iterator it;
+	for (it = mem_->begin(); it != mem_->end(); ++it) {
+		it->second->Dump(it->first);
 	}
 }
 
+const SymbolicMemoryWriter::MemElem* SymbolicMemoryWriter::FindPage(addr_t page) const {
+	if (!mem_)
+		return NULL;
+	PageMap::const_iterator it = mem_->find(page);
+	return (it == mem_->end()) ? NULL : it->second.get();
+}
+
+SymbolicMemoryWriter::MemElem* SymbolicMemoryWriter::MutablePage(addr_t page, bool create) {
+	if (!create && (FindPage(page) == NULL))
+		return NULL;
+
+	if (!mem_) {
+		mem_.reset(new PageMap());
+	} else if (mem_.use_count() > 1) {
+		mem_.reset(new PageMap(*mem_));
+	}
+
+	PageMap::iterator it = mem_->find(page);
+	if (it == mem_->end()) {
+		it = (mem_->insert(make_pair(page, std::make_shared<MemElem>()))).first;
+	} else if (it->second.use_count() > 1) {
+		it->second = std::make_shared<MemElem>(*it->second);
+	}
+	return it->second.get();
+}
+
 SymbolicExprWriter* SymbolicMemoryWriter::read(addr_t addr, Value_t val) const {
+	return read(addr, val, *this);
+}
+
+SymbolicExprWriter* SymbolicMemoryWriter::read(addr_t addr, Value_t val,
+		const SymbolicMemoryWriter& next_mem) const {
 	if (val.type == types::STRUCT)
 		return NULL;
 
-	hash_map<addr_t,MemElem>::const_iterator it = mem_.find(addr & MemElem::kAddrMask);
-	if (it == mem_.end())
+	const MemElem* elem = FindPage(addr & MemElem::kAddrMask);
+	if (elem == NULL)
 		return NULL;
 
 	MemElem default_elem;
-	const MemElem *next = &default_elem;
-	hash_map<addr_t,MemElem>::const_iterator it2 = mem_.find((addr + MemElem::kMemElemCapacity)
-			& MemElem::kAddrMask);
-	if (it2 != mem_.end()){
-		next = &(it2->second);
+	const MemElem *next = next_mem.FindPage((addr + MemElem::kMemElemCapacity) & MemElem::kAddrMask);
+	if (next == NULL){
+		next = &default_elem;
 	}
 
 	size_t n = kSizeOfType[val.type];
-	return it->second.read(addr, n, val, next);
+	return elem->read(addr, n, val, next);
 }
 
 
 void SymbolicMemoryWriter::write(addr_t addr, SymbolicExprWriter* e) {
 	assert(e != NULL);
-	hash_map<addr_t,MemElem>::iterator it = mem_.find(addr & MemElem::kAddrMask);
-	if (it == mem_.end()) {
-		it = (mem_.insert(make_pair(addr & MemElem::kAddrMask, MemElem()))).first;
-	}
-
-	it->second.write(addr, e->size(), e);
+	MutablePage(addr & MemElem::kAddrMask, true)->write(addr, e->size(), e);
 }
 
 
@@ -241,8 +269,8 @@ void SymbolicMemoryWriter::concretize(addr_t addr, size_t n) {
 
 	int left = static_cast<int>(n);
 	do {
-		hash_map<addr_t,MemElem>::iterator it = mem_.find(addr & MemElem::kAddrMask);
-		if (it == mem_.end()) {
+		MemElem* elem = MutablePage(addr & MemElem::kAddrMask, false);
+		if (elem == NULL) {
 			left -= MemElem::kMemElemCapacity - (addr & MemElem::kOffsetMask);
 			addr = (addr & MemElem::kAddrMask) + MemElem::kMemElemCapacity;
 			continue;
@@ -254,7 +282,7 @@ void SymbolicMemoryWriter::concretize(addr_t addr, size_t n) {
 		}
 
 		// Concretize.
-		it->second.write(addr, sz, NULL);
+		elem->write(addr, sz, NULL);
 
 		addr += sz;
 		left -= sz;
@@ -264,14 +292,77 @@ void SymbolicMemoryWriter::concretize(addr_t addr, size_t n) {
 
 void SymbolicMemoryWriter::Serialize(ostream &os) const {
 	// Format is :mem_size() | i | mem_[i]
-	size_t mem_size = mem_.size();
+	size_t mem_size = mem_ ? mem_->size() : 0;
 	os.write((char*)&mem_size, sizeof(size_t));
+	if (!mem_)
+		return;
 
 	// Now write the memory contents
-	hash_map<addr_t,MemElem>::const_iterator i;
-	for (i = mem_.begin(); i != mem_.end(); ++i) {
+	PageMap::const_iterator i;
+	for (i = mem_->begin(); i != mem_->end(); ++i) {
 		os.write((char*)&(i->first), sizeof(addr_t));
-		i->second.Serialize(os);
+		i->second->Serialize(os);
+	}
+}
+
+
+const size_t ShardedMemoryWriter::kShardPageSize;
+const size_t ShardedMemoryWriter::kNumShards;
+
+ShardedMemoryWriter::ShardedMemoryWriter() {
+	void* p = NULL;
+	if (posix_memalign(&p, alignof(Shard), kNumShards * sizeof(Shard)) != 0)
+		throw std::bad_alloc();
+	shards_ = static_cast<Shard*>(p);
+	for (size_t i = 0; i < kNumShards; i++)
+		new (&shards_[i]) Shard();
+}
+
+
+ShardedMemoryWriter::~ShardedMemoryWriter() {
+	for (size_t i = 0; i < kNumShards; i++)
+		shards_[i].~Shard();
+	free(shards_);
+}
+
+
+SymbolicExprWriter* ShardedMemoryWriter::read(addr_t addr, Value_t val) const {
+	if (val.type == types::STRUCT)
+		return NULL;
+
+	size_t first = ShardOf(addr);
+	size_t last = ShardOf(addr + kSizeOfType[val.type] - 1);
+	if (first == last) {
+		std::lock_guard<std::mutex> lock(shards_[first].lock);
+		return shards_[first].mem.read(addr, val);
+	}
+
+	std::unique_lock<std::mutex> lock1(shards_[min(first, last)].lock);
+	std::unique_lock<std::mutex> lock2(shards_[std::max(first, last)].lock);
+	return shards_[first].mem.read(addr, val, shards_[last].mem);
+}
+
+
+void ShardedMemoryWriter::write(addr_t addr, SymbolicExprWriter* e) {
+	// Only the page of addr is written (see MemElem::write).
+	Shard& shard = shards_[ShardOf(addr)];
+	std::lock_guard<std::mutex> lock(shard.lock);
+	shard.mem.write(addr, e);
+}
+
+
+void ShardedMemoryWriter::concretize(addr_t addr, size_t n) {
+	assert(n > 0);
+
+	while (n > 0) {
+		size_t len = min(n, kShardPageSize - (addr % kShardPageSize));
+		Shard& shard = shards_[ShardOf(addr)];
+		{
+			std::lock_guard<std::mutex> lock(shard.lock);
+			shard.mem.concretize(addr, len);
+		}
+		addr += len;
+		n -= len;
 	}
 }
 
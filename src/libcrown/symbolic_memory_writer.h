@@ -10,6 +10,8 @@
 #define SYMBOLIC_MEMORY_WRITER_H__
 
 #include <ext/hash_map>
+#include <memory>
+#include <mutex>
 #include "base/basic_types.h"
 #include <ostream>
 
@@ -21,6 +23,9 @@ namespace crown {
 
 class SymbolicExprWriter;
 
+// Copies share their pages (MemElems) copy-on-write: copying is O(1),
+// and a write to a shared page copies only that page (and, once, the
+// table of page pointers).
 class SymbolicMemoryWriter {
 	friend class Logger;
 public:
@@ -29,6 +34,9 @@ public:
 	~SymbolicMemoryWriter();
 
 	SymbolicExprWriter* read(addr_t addr, Value_t val) const;
+	// As read, but the page following addr's is looked up in next.
+	SymbolicExprWriter* read(addr_t addr, Value_t val,
+			const SymbolicMemoryWriter& next) const;
 
 	void write(addr_t addr, SymbolicExprWriter* e);
 
@@ -67,7 +75,51 @@ private:
 		SymbolicExprWriter* slots_[kMemElemCapacity];
 	};
 
-	__gnu_cxx::hash_map<addr_t, MemElem> mem_;
+	typedef __gnu_cxx::hash_map<addr_t, std::shared_ptr<MemElem> > PageMap;
+
+	const MemElem* FindPage(addr_t page) const;
+	// Returns an unshared page, or NULL if there is none and !create.
+	MemElem* MutablePage(addr_t page, bool create);
+
+	// NULL until the first write.
+	std::shared_ptr<PageMap> mem_;
+};
+
+// A SymbolicMemoryWriter split by (4 KB) page into shards, each with its
+// own lock, so that threads working on different pages do not contend.
+// A read that straddles two shards locks both, in shard order.
+class ShardedMemoryWriter {
+	friend class Logger;
+public:
+	ShardedMemoryWriter();
+	~ShardedMemoryWriter();
+
+	SymbolicExprWriter* read(addr_t addr, Value_t val) const;
+
+	void write(addr_t addr, SymbolicExprWriter* e);
+
+	void concretize(addr_t addr, size_t n);
+
+private:
+	static const size_t kShardPageSize = 4096;
+	static const size_t kNumShards = 64;
+
+	struct alignas(64) Shard {
+		mutable std::mutex lock;
+		SymbolicMemoryWriter mem;
+	};
+
+	static size_t ShardOf(addr_t addr) {
+		return (addr / kShardPageSize) % kNumShards;
+	}
+
+	// Allocated separately, cache-line aligned: an over-aligned member
+	// would make its owner (a SymbolicInterpreter, created with plain
+	// operator new) over-aligned too.
+	Shard* shards_;
+
+	ShardedMemoryWriter(const ShardedMemoryWriter&);
+	ShardedMemoryWriter& operator=(const ShardedMemoryWriter&);
 };
 
 }
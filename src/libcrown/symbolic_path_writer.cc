@@ -14,9 +14,27 @@
 
 namespace crown {
 
-SymbolicPathWriter::SymbolicPathWriter() { }
+namespace {
+
+// Maps a hit count onto one of the buckets 1, 2, 3, 4-7, 8-15, 16-31,
+// 32-127 and 128+ (one bit each).
+unsigned char BucketHitCount(unsigned char count) {
+	if (count == 0)   return 0;
+	if (count <= 2)   return count;
+	if (count == 3)   return 4;
+	if (count < 8)    return 8;
+	if (count < 16)   return 16;
+	if (count < 32)   return 32;
+	if (count < 128)  return 64;
+	return 128;
+}
+
+}  // namespace
+
+SymbolicPathWriter::SymbolicPathWriter() : site_budget_(0), dropped_(0) { }
 
-SymbolicPathWriter::SymbolicPathWriter(bool pre_allocate) {
+SymbolicPathWriter::SymbolicPathWriter(bool pre_allocate)
+	: site_budget_(0), dropped_(0) {
 	if (pre_allocate) {
 		// To cut down on re-allocation.
 		branches_.reserve(4000000);
@@ -28,7 +46,11 @@ SymbolicPathWriter::SymbolicPathWriter(bool pre_allocate) {
 SymbolicPathWriter::SymbolicPathWriter(const SymbolicPathWriter &p)
 	: branches_(p.branches_),
 	constraints_idx_(p.constraints_idx_),
-	constraints_(p.constraints_) {
+	constraints_(p.constraints_),
+	hits_(p.hits_),
+	site_budget_(p.site_budget_),
+	dropped_(0) {
+		assert(p.dropped_ == 0);
 		for(size_t i = 0; i < p.constraints_.size(); i++)
 			constraints_[i] = p.constraints_[i]->Clone();
 	}
@@ -40,12 +62,26 @@ SymbolicPathWriter::~SymbolicPathWriter() {
 }
 
 void SymbolicPathWriter::Swap(SymbolicPathWriter& sp) {
+	locations_.swap(sp.locations_);
 	branches_.swap(sp.branches_);
 	constraints_idx_.swap(sp.constraints_idx_);
 	constraints_.swap(sp.constraints_);
+	hits_.swap(sp.hits_);
+	sites_.swap(sp.sites_);
+	swap(dropped_, sp.dropped_);
+}
+
+void SymbolicPathWriter::CountHit(branch_id_t bid) {
+	if (bid <= 0)
+		return;
+	if (static_cast<size_t>(bid) >= hits_.size())
+		hits_.resize(2 * bid, 0);
+	if (hits_[bid] != 255)
+		hits_[bid]++;
 }
 
 void SymbolicPathWriter::Push(branch_id_t bid) {
+	CountHit(bid);
 	branches_.push_back(bid);
 }
 
@@ -72,26 +108,82 @@ void SymbolicPathWriter::Push(branch_id_t bid, SymbolicExprWriter* constraint,
 			constraints_idx_.push_back(branches_.size());
 		}
 	}
+	CountHit(bid);
 	branches_.push_back(bid);
 }
 
 void SymbolicPathWriter::Push(branch_id_t bid, SymbolicExprWriter* constraint, bool pred_value,
-		unsigned int lineno, const char *filename, const char *exp){
+		unsigned int lineno, const char *filename, const char *exp, size_t site){
 	Push(bid, constraint, lineno, filename);
+	if (constraint && site_budget_)
+		ApplySiteBudget(site);
 	//branch_info_.push_back(branch_info_t(pred_value, lineno, filename, exp));
 }
 
+void SymbolicPathWriter::ApplySiteBudget(size_t site) {
+	Site& s = sites_[site];
+	if (++s.count <= site_budget_)
+		return;
+	s.tail.push_back(constraints_.size() - 1);
+	if (s.tail.size() <= site_budget_)
+		return;
+	// No longer among the last site_budget_: drop it.
+	size_t i = s.tail.front();
+	s.tail.pop_front();
+	delete constraints_[i];
+	constraints_[i] = NULL;
+	dropped_++;
+}
+
+void SymbolicPathWriter::Compact() {
+	if (dropped_ == 0)
+		return;
+	size_t n = 0;
+	for (size_t i = 0; i < constraints_.size(); i++) {
+		if (constraints_[i] == NULL)
+			continue;
+		constraints_[n] = constraints_[i];
+		constraints_idx_[n] = constraints_idx_[i];
+		locations_[n] = locations_[i];
+		n++;
+	}
+	constraints_.resize(n);
+	constraints_idx_.resize(n);
+	locations_.resize(n);
+	sites_.clear();
+	dropped_ = 0;
+}
+
+void SymbolicPathWriter::MoveBranchFrom(SymbolicPathWriter* sp, size_t i, size_t* c) {
+	if ((*c < sp->constraints_.size()) && (sp->constraints_idx_[*c] == i)) {
+		locations_.push_back(sp->locations_[*c]);
+		constraints_.push_back(sp->constraints_[*c]);
+		constraints_idx_.push_back(branches_.size());
+		sp->constraints_[*c] = NULL;
+		(*c)++;
+	}
+	CountHit(sp->branches_[i]);
+	branches_.push_back(sp->branches_[i]);
+}
+
 
 void SymbolicPathWriter::Serialize(ostream &os) const{
-	typedef vector<SymbolicExprWriter*>::const_iterator ConIt;
+	SerializeBranches(os);
+	SerializeConstraints(os);
+}
 
+void SymbolicPathWriter::SerializeBranches(ostream &os) const{
 	// Write the path.
 	size_t len = branches_.size();
 	os.write((char*)&len, sizeof(len));
 	os.write((char*)&branches_.front(), branches_.size() * sizeof(branch_id_t));
+}
+
+void SymbolicPathWriter::SerializeConstraints(ostream &os) const{
+	typedef vector<SymbolicExprWriter*>::const_iterator ConIt;
 
 	// Write the path constraints.
-	len = constraints_.size();
+	size_t len = constraints_.size();
 	os.write((char*)&len, sizeof(len));
 	os.write((char*)&constraints_idx_.front(), constraints_.size() * sizeof(size_t));
     
@@ -111,4 +203,16 @@ void SymbolicPathWriter::Serialize(ostream &os) const{
 	}
 }
 
+void SymbolicPathWriter::SerializeHits(ostream &os) const{
+	// Write the bucketed hit counts.
+	vector<unsigned char> buckets(hits_.size());
+	for (size_t i = 0; i < hits_.size(); i++)
+		buckets[i] = BucketHitCount(hits_[i]);
+
+	size_t len = buckets.size();
+	os.write((char*)&len, sizeof(len));
+	if (len > 0)
+		os.write((char*)&buckets.front(), len);
+}
+
 }  // namespace crown
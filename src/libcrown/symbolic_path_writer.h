@@ -12,6 +12,8 @@
 #define SYMBOLIC_PATH_WRITER_H__
 
 #include <algorithm>
+#include <deque>
+#include <ext/hash_map>
 #include <istream>
 #include <ostream>
 #include <vector>
@@ -19,6 +21,7 @@
 #include "base/basic_types.h"
 #include "libcrown/symbolic_expression_writer.h"
 
+using std::deque;
 using std::istream;
 using std::ostream;
 using std::swap;
@@ -44,8 +47,27 @@ public:
      */
 	void Push(branch_id_t bid, SymbolicExprWriter* constraint, unsigned int lineno, const char *filename);
 	void Push(branch_id_t bid, SymbolicExprWriter* constraint, bool pred_value, 
-			unsigned int lineno, const char *filename, const char *exp);
+			unsigned int lineno, const char *filename, const char *exp,
+			size_t site = 0);
+
+	// Keep at most the first and the last budget constraints pushed for
+	// each site (e.g., branch id and calling context); 0 means no limit.
+	// The branches of dropped constraints stay in the path.
+	void set_site_budget(size_t budget) { site_budget_ = budget; }
+
+	// Removes the dropped constraints.  Must be called before the path is
+	// serialized or its branches are moved.
+	void Compact();
+
+	// Moves branch i of sp, and its constraint if it has one, to the end of
+	// this path.  Branches must be moved in order; *c is the index of the
+	// next constraint of sp.
+	void MoveBranchFrom(SymbolicPathWriter* sp, size_t i, size_t* c);
+
 	void Serialize(ostream &os) const;
+	void SerializeBranches(ostream &os) const;
+	void SerializeConstraints(ostream &os) const;
+	void SerializeHits(ostream &os) const;
 
 	const vector<branch_id_t>& branches() const { return branches_; }
 	const vector<SymbolicExprWriter*>& constraints() const { return constraints_; }
@@ -60,6 +82,26 @@ private:
 	vector<branch_id_t> branches_;
 	vector<size_t> constraints_idx_;
 	vector<SymbolicExprWriter*> constraints_;
+
+	// Saturating hit count per branch id.  Serialized in AFL-style
+	// buckets (one bit per bucket) so run_crown can detect new coverage
+	// with wide compares.
+	vector<unsigned char> hits_;
+
+	inline void CountHit(branch_id_t bid);
+
+	// Constraints pushed so far at a site, and the indices of those that
+	// may still be among its last site_budget_.
+	struct Site {
+		Site() : count(0) { }
+		size_t count;
+		deque<size_t> tail;
+	};
+	size_t site_budget_;
+	__gnu_cxx::hash_map<size_t, Site> sites_;
+	size_t dropped_;
+
+	void ApplySiteBudget(size_t site);
 };
 
 }  // namespace crown
@@ -7,6 +7,7 @@
 
 #define SIZE 255
 #define FILE_NOT_EXIST "crown_replay: Input file '%s' does not exist\n"
+#define TC_NOT_IN_PACK "crown_replay: No test case %s in '%s'\n"
 #define NO_AVAILABLE_SYM_VAL "crown_replay: No available symbolic value in the input file\n"
 #define NON_NUMBER_SYM_VAL "crown_replay: Non-number symbolic value: %s"
 #define NON_BINARY_SYM_VAL "crown_replay: Non-binary symbolic value: %s"
@@ -17,6 +18,11 @@
 
 static FILE *f = NULL;
 static char *tc_file = NULL;
+// True if the input file is in the binary format (see InputRecord).
+static bool binary_input = false;
+// Number of records left in a test case read from a pack, or -1 if the
+// input file is read to its end.
+static long long records_left = -1;
 
 // Converts binary string (of length 32) to float.
 float binStringToFloat(const char* binFloat){
@@ -80,6 +86,53 @@ bool isbinary(char *buf)
     return true;
 }
 
+// Opens the pack in tc_dir at the test case of iteration tc_id, as
+// listed in the pack's index (see TestCaseIndex).
+// If there is no such test case, exit program.
+void read_pack_entry(const char *tc_dir, const char *tc_id)
+{
+    static char pack[SIZE], index[SIZE];
+    snprintf(pack, sizeof(pack), "%s/%s", tc_dir, crown::kTestCasePack);
+    snprintf(index, sizeof(index), "%s/%s", tc_dir, crown::kTestCaseIndex);
+    tc_file = pack;
+
+    FILE *idx = fopen(index, "r");
+    if(!idx)
+    {
+        fprintf(stderr, FILE_NOT_EXIST, index);
+        exit(1);
+    }
+    unsigned int iteration = strtoul(tc_id, NULL, 10);
+    crown::TestCaseIndex entry;
+    bool found = false;
+    while(!found && fread(&entry, sizeof(entry), 1, idx) == 1)
+        found = (entry.iteration == iteration);
+    fclose(idx);
+    if(!found)
+    {
+        fprintf(stderr, TC_NOT_IN_PACK, tc_id, index);
+        exit(1);
+    }
+
+    f = fopen(pack, "r");
+    if(!f)
+    {
+        fprintf(stderr, FILE_NOT_EXIST, pack);
+        exit(1);
+    }
+    unsigned int magic = 0;
+    if(fseek(f, entry.offset, SEEK_SET) != 0
+            || entry.length < sizeof(magic)
+            || fread(&magic, sizeof(magic), 1, f) != 1
+            || magic != crown::kInputMagic)
+    {
+        fprintf(stderr, TC_NOT_IN_PACK, tc_id, pack);
+        exit(1);
+    }
+    binary_input = true;
+    records_left = (entry.length - sizeof(magic)) / sizeof(crown::InputRecord);
+}
+
 // When CROWN function is called for the first time,
 // (i.e., f is not initialized yet)
 // raed the input file.
@@ -87,6 +140,16 @@ void read_input_file()
 {
     if(!f)
     {
+        // If CROWN_TC_DIR and CROWN_TC_ID are set, read the test case of
+        // iteration CROWN_TC_ID from the pack run_crown -TCDIR wrote there.
+        char *tc_dir = getenv("CROWN_TC_DIR");
+        char *tc_id = getenv("CROWN_TC_ID");
+        if(tc_dir && tc_id)
+        {
+            read_pack_entry(tc_dir, tc_id);
+            return;
+        }
+
         // Read the file name of test_input from the environment CROWN_TC_FILE.
         // (CROWN_replay sets this value)
         tc_file = getenv("CROWN_TC_FILE");
@@ -99,7 +162,28 @@ void read_input_file()
             fprintf(stderr, FILE_NOT_EXIST, tc_file);
             exit(1);
         }
+        // Check for the binary format; otherwise read it as text.
+        unsigned int magic = 0;
+        if(fread(&magic, sizeof(magic), 1, f) == 1 && magic == crown::kInputMagic)
+            binary_input = true;
+        else
+            rewind(f);
+    }
+}
+
+// Read the next record of a binary input file.
+// If there is no record left, exit program.
+crown::InputRecord read_input_record()
+{
+    crown::InputRecord rec;
+    if(records_left == 0 || fread(&rec, sizeof(rec), 1, f) != 1)
+    {
+        fprintf(stderr,NO_AVAILABLE_SYM_VAL);
+        exit(1);
     }
+    if(records_left > 0)
+        records_left--;
+    return rec;
 }
 
 // Returns true if overflow occurs when the symbolic value is assigned to
@@ -145,6 +229,12 @@ void __CrownUChar(unsigned char *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (unsigned char)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -178,6 +268,12 @@ void __CrownUShort(unsigned short *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (unsigned short)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -211,6 +307,12 @@ void __CrownUInt(unsigned int *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (unsigned int)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -244,6 +346,12 @@ void __CrownULong(unsigned long *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (unsigned long)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -277,6 +385,12 @@ void __CrownULongLong(unsigned long long *x, int cnt_sym_var, int ln, char* fnam
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (unsigned long long)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -310,6 +424,12 @@ void __CrownChar(char *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (char)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -342,6 +462,12 @@ void __CrownShort(short *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (short)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -374,6 +500,12 @@ void __CrownInt(int *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (int)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -406,6 +538,12 @@ void __CrownLong(long *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (long)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -438,6 +576,12 @@ void __CrownLongLong(long long *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (long long)crown::InputRecordToValue(read_input_record()).integral;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -470,6 +614,12 @@ void __CrownFloat(float *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (float)crown::InputRecordToValue(read_input_record()).floating;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -495,6 +645,12 @@ void __CrownDouble(double *x, int cnt_sym_var, int ln, char* fname, ...)
 {
     read_input_file();
 
+    if(binary_input)
+    {
+        *x = (double)crown::InputRecordToValue(read_input_record()).floating;
+        return;
+    }
+
     char buf[SIZE];
     // Read the type, but it will not be used.
     fgets(buf,sizeof(buf), f);
@@ -600,13 +756,33 @@ unsigned long long __CrownBitField(unsigned char * x, char unionSize, int lowest
 		
 		read_input_file();
 
-    char buf[SIZE];
-    // Read the type,
-    fgets(buf,sizeof(buf), f);
 		int hBit = 0,lBit = 0,indexSize = 0,bfsize = 0;
 		unsigned long long result= 0, ll= 0;
 		int i = 0;
 
+		if(binary_input){
+				crown::InputRecord rec = read_input_record();
+				hBit = rec.h;
+				lBit = rec.l;
+				indexSize = rec.index_size;
+				if(indexSize == 0){ //union
+						return (rec.bits >> lBit) & ((1ULL << (hBit - lBit)) - 1);
+				}
+				for ( i = 0; i < indexSize; i++){ //struct
+						result = (((rec.bits >> lBit) & ( (1ULL << (hBit - lBit)) - 1)) << bfsize) | result;
+						bfsize += (hBit - lBit);
+						if( i == indexSize - 1) return result;
+						rec = read_input_record();
+						hBit = rec.h;
+						lBit = rec.l;
+				}
+				return 0; //should not be reached.
+		}
+
+    char buf[SIZE];
+    // Read the type,
+    fgets(buf,sizeof(buf), f);
+
 		char * bufblock;
 
 		bufblock = strtok(buf, " ");
@@ -42,6 +42,14 @@ Z3_ast AtomicExpr::ConvertToSMT(Z3_context ctx, Z3_solver sol) const {
 	return x_decl[var_];
 }
 
+bool AtomicExpr::Evaluate(const Assignment& a, Value_t* out) const {
+	Assignment::const_iterator it = a.find(var_);
+	if (it == a.end())
+		return false;
+	*out = it->second;
+	return true;
+}
+
 bool AtomicExpr::Equals(const SymbolicExpr &e) const {
 	const AtomicExpr* b = e.CastAtomicExpr();
 	return (b != NULL) && (var_ == b->var_);
@@ -41,6 +41,7 @@ public:
 	bool IsConcrete() const { return false; }
 
 	Z3_ast ConvertToSMT(Z3_context ctx, Z3_solver sol) const;
+	bool Evaluate(const Assignment& a, Value_t* out) const;
 
 	const AtomicExpr* CastAtomicExpr() const { return this; }
 
@@ -237,6 +237,94 @@ Z3_ast BinExpr::ConvertToSMTforFP(Z3_context ctx, Z3_solver sol,
 	}
 }
 
+bool BinExpr::Evaluate(const Assignment& a, Value_t* out) const {
+	Value_t l, r;
+	if (!left_->Evaluate(a, &l) || !right_->Evaluate(a, &r))
+		return false;
+	if (left_->value().type == types::LONG_DOUBLE
+			|| right_->value().type == types::LONG_DOUBLE)
+		return false;
+
+	if (IsFloatType(left_->value().type) && IsFloatType(right_->value().type)) {
+		fp_value_t f;
+		switch (binary_op_) {
+			case ops::ADD:      f = l.floating + r.floating; break;
+			case ops::SUBTRACT: f = l.floating - r.floating; break;
+			case ops::MULTIPLY: f = l.floating * r.floating; break;
+			case ops::DIV:
+			case ops::S_DIV:    f = l.floating / r.floating; break;
+			default:
+				return false;
+		}
+		*out = MakeFloatValue(f);
+		return true;
+	}
+	if (IsFloatType(left_->value().type) || IsFloatType(right_->value().type))
+		return false;
+
+	// Operands as unsigned and as signed values of their own width.
+	size_t lsize = left_->size(), rsize = right_->size();
+	unsigned long long lu = Truncate(l.integral, lsize, false);
+	unsigned long long ru = Truncate(r.integral, rsize, false);
+	value_t ls = Truncate(l.integral, lsize, true);
+	value_t rs = Truncate(r.integral, rsize, true);
+	unsigned long long res;
+
+	switch (binary_op_) {
+		case ops::ADD:         res = lu + ru; break;
+		case ops::SUBTRACT:    res = lu - ru; break;
+		case ops::MULTIPLY:    res = lu * ru; break;
+		case ops::BITWISE_AND: res = lu & ru; break;
+		case ops::BITWISE_OR:  res = lu | ru; break;
+		case ops::BITWISE_XOR: res = lu ^ ru; break;
+		case ops::DIV:
+			if (ru == 0) return false;
+			res = lu / ru;
+			break;
+		case ops::MOD:
+			if (ru == 0) return false;
+			res = lu % ru;
+			break;
+		case ops::S_DIV:
+			if (rs == 0 || (ls == kMinValue[types::LONG_LONG] && rs == -1))
+				return false;
+			res = ls / rs;
+			break;
+		case ops::S_MOD:
+			if (rs == 0 || (ls == kMinValue[types::LONG_LONG] && rs == -1))
+				return false;
+			res = ls % rs;
+			break;
+		case ops::SHIFT_L:
+			if (ru >= 8 * size()) return false;
+			res = lu << ru;
+			break;
+		case ops::SHIFT_R:
+			if (ru >= 8 * size()) return false;
+			res = lu >> ru;
+			break;
+		case ops::S_SHIFT_R:
+			if (ru >= 8 * size()) return false;
+			res = ls >> ru;
+			break;
+		case ops::CONCAT:
+			// left_ holds the high-order bytes.
+			if (lsize + rsize > sizeof(value_t)) return false;
+			res = (lu << (8 * rsize)) | ru;
+			break;
+		case ops::EXTRACT:
+			// Byte offset; a negative one is rejected as a huge ru.
+			if (ru >= sizeof(value_t)) return false;
+			res = lu >> (8 * ru);
+			break;
+		default:
+			return false;
+	}
+
+	*out = MakeValue((value_t)res);
+	return true;
+}
+
 bool BinExpr::Equals(const SymbolicExpr &e) const {
 	const BinExpr* b = e.CastBinExpr();
 	return ((b != NULL)
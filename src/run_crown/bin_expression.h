@@ -37,6 +37,7 @@ public:
 	Z3_ast ConvertToSMT(Z3_context ctx, Z3_solver sol) const;
 	Z3_ast ConvertToSMTforBV(Z3_context ctx, Z3_solver sol,Z3_ast e1, Z3_ast e2) const;
 	Z3_ast ConvertToSMTforFP(Z3_context ctx, Z3_solver sol,Z3_ast e1, Z3_ast e2) const;
+	bool Evaluate(const Assignment& a, Value_t* out) const;
 
 	const BinExpr* CastBinExpr() const { return this; }
 
@@ -48,6 +49,8 @@ public:
 	const SymbolicExpr* get_right() const { return right_; }
 
 private:
+	friend class SymbolicExprSimplifier;
+
 	const ops::binary_op_t binary_op_;
 	const SymbolicExpr *left_, *right_;
 };
@@ -23,8 +23,13 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "run_crown/z3_solver.h"
+#include "run_crown/syntactic_check.h"
+#include "run_crown/fp_local_search.h"
 #include "run_crown/concolic_search.h"
 #include "base/basic_types.h"
 #include "base/basic_functions.h"
@@ -47,12 +52,14 @@ unsigned long long crown::Z3Solver::no_reduction_sat_formula_length = 0;
 unsigned long long crown::Z3Solver::no_reduction_unsat_formula_length = 0;
 
 /* TCdir (defined in crown-fp/src/run_crown.cc) is a relative directory path 
- * to save generated test cases files * (i.e. input.1, input.2, ...)
+ * to save generated test cases in (i.e. inputs.pack and inputs.idx)
  * TCdir is empty if -TCDIR commandline option is not used.
  * 2017.07.07 Hyunwoo Kim 
  */
 extern string TCdir;
 extern int flag_init_TC;
+extern int flag_fp_local_search;
+extern int flag_preserve_inputs;
 
 namespace crown {
 
@@ -67,6 +74,29 @@ struct ScoredBranchComp
 	}
 };
 
+const size_t kCoverageMapAlign = 16;
+
+// Returns true if some branch has a hit-count bucket set in cur that is
+// not set in seen.  Both maps must have at least n bytes.
+bool HasNewCoverage(const unsigned char* cur, const unsigned char* seen, size_t n) {
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seen + i));
+		acc = _mm_or_si128(acc, _mm_andnot_si128(v, c));
+	}
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xffff)
+		return true;
+#endif
+	for (; i < n; i++) {
+		if (cur[i] & ~seen[i])
+			return true;
+	}
+	return false;
+}
+
 }  // namespace
 
 
@@ -75,8 +105,13 @@ struct ScoredBranchComp
 ////////////////////////////////////////////////////////////////////////
 
 Search::Search(const string& program, int max_iterations)
-  : sym_path_length(0), con_path_length(0),
-    program_(program), max_iters_(max_iterations), num_iters_(0){
+  : sym_path_length(0), con_path_length(0), branch_only_(false),
+    program_(program), max_iters_(max_iterations), num_iters_(0),
+    tc_pack_(NULL), tc_index_(NULL), tc_pack_size_(0),
+    z3_queries_(0), z3_solved_(0), demoted_queries_(0), core_hits_(0),
+    predictions_(0), failed_predictions_(0),
+    syntactic_queries_(0), syntactic_unsat_(0), syntactic_sat_(0),
+    cache_queries_(0), cache_hits_(0), coverage_file_(NULL) {
 
 	start_time_ = time(NULL);
 
@@ -113,6 +148,8 @@ Search::Search(const string& program, int max_iterations)
 		paired_branch_[branches_[i]] = branches_[i+1];
 		paired_branch_[branches_[i+1]] = branches_[i];
 	}
+	solver_unknowns_.resize(max_branch_, 0);
+	unsat_cores_.resize(max_branch_);
 
 	// Compute the branch-to-function map.
 	branch_function_.resize(max_branch_);
@@ -128,8 +165,9 @@ Search::Search(const string& program, int max_iterations)
 	// Initialize all branches to "uncovered" (and functions to "unreached").
 	total_num_covered_ = num_covered_ = 0;
 	reachable_functions_ = reachable_branches_ = 0;
-	covered_.resize(max_branch_, false);
-	total_covered_.resize(max_branch_, false);
+	size_t map_size = (max_branch_ + kCoverageMapAlign - 1) & ~(kCoverageMapAlign - 1);
+	covered_.resize(map_size, 0);
+	total_covered_.resize(map_size, 0);
 	reached_.resize(max_function_, false);
 
 #if 0
@@ -137,7 +175,7 @@ Search::Search(const string& program, int max_iterations)
 		ifstream in("coverage");
 		branch_id_t bid;
 		while (in >> bid) {
-			covered_[bid] = true;
+			covered_[bid] = 1;
 			num_covered_ ++;
 			if (!reached_[branch_function_[bid]]) {
 				reached_[branch_function_[bid]] = true;
@@ -161,6 +199,16 @@ Search::Search(const string& program, int max_iterations)
 
 
 Search::~Search() {
+	CloseTestCasesOrDie();
+	PrintSolverStats();
+	for (size_t i = 0; i < unsat_cores_.size(); i++) {
+		for (size_t j = 0; j < unsat_cores_[i].size(); j++)
+			FreeUnsatCore(&unsat_cores_[i][j]);
+	}
+	if (coverage_file_ != NULL) {
+		fclose(coverage_file_);
+		WriteCoverageToFileOrDie("coverage");
+	}
 
 #if 0
 	fprintf(stderr, "Path count: %u\n", Z3Solver::path_cnt_);
@@ -207,41 +255,113 @@ Search::~Search() {
 }
 
 
-void Search::WriteInputToFileOrDie(const string& file,
-		const vector<Value_t>& input, const vector<unsigned char>& h, const vector<unsigned char>& l, const vector<unsigned char>& idx) {
-	FILE* f = fopen(file.c_str(), "w");
+void Search::SerializeInput(const vector<Value_t>& input,
+		const vector<unsigned char>& h, const vector<unsigned char>& l,
+		const vector<unsigned char>& idx, string* out) {
+	out->clear();
+	out->reserve(sizeof(kInputMagic) + input.size() * sizeof(InputRecord));
+	out->append((const char*)&kInputMagic, sizeof(kInputMagic));
+
+	for (size_t i = 0; i < input.size(); i++) {
+#ifdef DEBUG
+		std::cerr<<"Next Input value: "<<input[i].integral <<" "<<input[i].floating<<" "<<input[i].type <<std::endl;
+#endif
+		InputRecord rec = ValueToInputRecord(input[i],
+				(i < h.size()) ? h[i] : 0,
+				(i < l.size()) ? l[i] : 0,
+				(i < idx.size()) ? idx[i] : 0);
+		out->append((const char*)&rec, sizeof(rec));
+	}
+}
+
+
+void Search::WriteBufferToFileOrDie(const string& file, const string& buf) {
+	FILE* f = fopen(file.c_str(), "wb");
 	if (!f) {
 		fprintf(stderr, "Failed to open %s.\n", file.c_str());
 		perror("Error: ");
 		exit(-1);
 	}
 
-	for (size_t i = 0; i < input.size(); i++) {
-#ifdef DEBUG
-		std::cerr<<"Next Input value: "<<input[i].integral <<" "<<input[i].floating<<" "<<input[i].type <<std::endl;
-#endif
-		if((int) h[i] == 0){
-			fprintf(f, "%d\n",(int)input[i].type);
-		} else {
-			fprintf(f, "%d %d %d %d\n", (int)input[i].type, (int) h[i], (int) l[i], (int) idx[i]);
-		}
-		if(input[i].type == types::FLOAT){
-			fwrite(crown::floatToBinString((float)input[i].floating)->c_str(),
-					sizeof(char), sizeof(float)*8, f);
-			fprintf(f, "\n");
-		}else if(input[i].type == types::DOUBLE){
-			fwrite(crown::doubleToBinString((double)input[i].floating)->c_str(),
-					sizeof(char), sizeof(double)*8, f);
-			fprintf(f, "\n");
-		}else{
-			fprintf(f, "%lld\n", input[i].integral);
-		}
+	if (!buf.empty()) {
+		fwrite(buf.data(), sizeof(char), buf.size(), f);
 	}
 
 	fclose(f);
 }
 
 
+void Search::WriteInputToFileOrDie(const string& file,
+		const vector<Value_t>& input, const vector<unsigned char>& h, const vector<unsigned char>& l, const vector<unsigned char>& idx) {
+	string buf;
+	SerializeInput(input, h, l, idx, &buf);
+	WriteBufferToFileOrDie(file, buf);
+}
+
+
+void Search::PrintSolverStats() {
+	fprintf(stderr, "Syntactic check: %zu unsat, %zu sat of %zu queries\n",
+			syntactic_unsat_, syntactic_sat_, syntactic_queries_);
+	fprintf(stderr, "Unsat cores: %zu queries skipped\n", core_hits_);
+	fprintf(stderr, "Predictions: %zu failed of %zu checked\n",
+			failed_predictions_, predictions_);
+	fprintf(stderr, "Model cache: solved %zu of %zu queries\n",
+			cache_hits_, cache_queries_);
+	if (flag_fp_local_search) {
+		fprintf(stderr, "FP local search: solved %zu of %zu queries\n",
+				FPLocalSearch::num_solved_, FPLocalSearch::num_queries_);
+	}
+	fprintf(stderr, "Z3: solved %zu of %zu queries\n", z3_solved_, z3_queries_);
+	Z3Solver::PrintPortfolioStats();
+	if (Z3Solver::unknown_count_ || demoted_queries_) {
+		fprintf(stderr, "Z3: %zu unknown (%ld.%03lds), %zu queries skipped on demoted branches\n",
+				Z3Solver::unknown_count_, Z3Solver::unknown_time_ / 1000,
+				Z3Solver::unknown_time_ % 1000, demoted_queries_);
+	}
+}
+
+
+void Search::AppendTestCaseOrDie(const string& buf) {
+	if (tc_pack_ == NULL) {
+		string pack = TCdir + "/" + kTestCasePack;
+		string index = TCdir + "/" + kTestCaseIndex;
+		tc_pack_ = fopen(pack.c_str(), "ab");
+		tc_index_ = fopen(index.c_str(), "ab");
+		if (!tc_pack_ || !tc_index_) {
+			fprintf(stderr, "Failed to open %s.\n", tc_pack_ ? index.c_str() : pack.c_str());
+			perror("Error: ");
+			exit(-1);
+		}
+	}
+
+	TestCaseIndex entry;
+	entry.iteration = num_iters_;
+	entry.reserved = 0;
+	entry.offset = tc_pack_size_;
+	entry.length = buf.size();
+
+	// Flushed right away, so a run that is killed keeps every test case
+	// it has generated.
+	if ((fwrite(buf.data(), sizeof(char), buf.size(), tc_pack_) != buf.size())
+			|| (fwrite(&entry, sizeof(entry), 1, tc_index_) != 1)
+			|| fflush(tc_pack_) || fflush(tc_index_)) {
+		fprintf(stderr, "Failed to write test case %d.\n", num_iters_);
+		perror("Error: ");
+		exit(-1);
+	}
+	tc_pack_size_ += buf.size();
+}
+
+
+void Search::CloseTestCasesOrDie() {
+	if (tc_pack_ != NULL) {
+		fclose(tc_pack_);
+		fclose(tc_index_);
+		tc_pack_ = tc_index_ = NULL;
+	}
+}
+
+
 void Search::WriteCoverageToFileOrDie(const string& file) {
 	FILE* f = fopen(file.c_str(), "w");
 	if (!f) {
@@ -260,6 +380,24 @@ void Search::WriteCoverageToFileOrDie(const string& file) {
 }
 
 
+void Search::AppendCoverageToFileOrDie(const string& file,
+		const vector<branch_id_t>& bids) {
+	if (coverage_file_ == NULL) {
+		coverage_file_ = fopen(file.c_str(), "w");
+		if (!coverage_file_) {
+			fprintf(stderr, "Failed to open %s.\n", file.c_str());
+			perror("Error: ");
+			exit(-1);
+		}
+	}
+
+	for (BranchIt i = bids.begin(); i != bids.end(); ++i) {
+		fprintf(coverage_file_, "%d\n", *i);
+	}
+	fflush(coverage_file_);
+}
+
+
 int Search::LaunchProgram(const vector<Value_t>& inputs) {
     int ret;
 	vector<unsigned char> tmph = vector<unsigned char>();
@@ -316,6 +454,13 @@ void Search::RunProgram(const vector<Value_t>& inputs, SymbolicExecution* ex) {
 				total_utime.tv_sec, total_utime.tv_usec/1000);
 #endif
 		// TODO(jburnim): Devise a better system for capping the iterations.
+		CloseTestCasesOrDie();
+		PrintSolverStats();
+		if (coverage_file_ != NULL) {
+			fclose(coverage_file_);
+			coverage_file_ = NULL;
+			WriteCoverageToFileOrDie("coverage");
+		}
 		exit(0);
 	}
 
@@ -329,7 +474,12 @@ void Search::RunProgram(const vector<Value_t>& inputs, SymbolicExecution* ex) {
 	global_numOfExpr_ = 0;
 	global_numOfVar_ = 0;
 	global_numOfOperator_ = 0;
-	assert(in && ex->Parse(in));
+	if (branch_only_) {
+		assert(in && ex->ParseBranches(in));
+	} else {
+		assert(in && ex->Parse(in));
+		ex->mutable_path()->Simplify();
+	}
 	//std::cout<<"Parse time "<<((double)clock() - clk)/CLOCKS_PER_SEC<<" numOfExpr "<<global_numOfExpr_<<" op "<<global_numOfOperator_<<" var "<<global_numOfVar_<<std::endl;
 	in.close();
 
@@ -339,7 +489,8 @@ void Search::RunProgram(const vector<Value_t>& inputs, SymbolicExecution* ex) {
 	/* This part saves test case files in TCdir if TCdir is not empty.
 	 * Note 1. if the directory pointed by TCdir already exists,
 	 *         test cases files are not saved.
-	 * Note 2. The length of path should be shorter than BUFSIZ (>255).
+	 * Note 2. Each test case is appended to TCdir/inputs.pack and
+	 *         indexed in TCdir/inputs.idx (see AppendTestCaseOrDie).
 	 * 2017.07.07 Hyunwoo Kim
 	 *
 	 * Moved the input.<N> generation code to the end of RunProgram().
@@ -367,14 +518,13 @@ void Search::RunProgram(const vector<Value_t>& inputs, SymbolicExecution* ex) {
 
 		if (status != -1)
 		{
-			char fname[BUFSIZ] = {0,};
-			snprintf(fname, BUFSIZ, "%s/input.%d",
-					TCdir.c_str(), num_iters_);
+			string buf;
             if (WIFEXITED(exitcode) != 0){
-    			WriteInputToFileOrDie(fname, ex->inputs(), ex->h(), ex->l(), ex->indexSize());
+    			SerializeInput(ex->inputs(), ex->h(), ex->l(), ex->indexSize(), &buf);
             }else{
-                WriteInputToFileOrDie(fname, inputs, ex->h(), ex->l(), ex->indexSize());
+                SerializeInput(inputs, ex->h(), ex->l(), ex->indexSize(), &buf);
             }
+			AppendTestCaseOrDie(buf);
 		}
 	}
 }
@@ -386,32 +536,53 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex) {
 
 bool Search::UpdateCoverage(const SymbolicExecution& ex,
 		set<branch_id_t>* new_branches) {
+	return UpdateCoverage(ex, new_branches, NULL);
+}
+
+bool Search::UpdateCoverage(const SymbolicExecution& ex,
+		set<branch_id_t>* new_branches, bool* new_bucket) {
 
 	const unsigned int prev_covered_ = num_covered_;
-	const SymbolicPath &path = ex.path();
-	const vector<branch_id_t>& branches = path.branches();
-
-	for (BranchIt i = branches.begin(); i != branches.end(); ++i) {
-		if ((*i > 0) && !covered_[*i]) {
-			covered_[*i] = true;
-			num_covered_++;
-			if (new_branches) {
-				new_branches->insert(*i);
+	const vector<unsigned char>& hits = ex.path().hits();
+	const size_t n = min(hits.size(), covered_.size());
+	vector<branch_id_t> new_total;
+
+	// total_covered_ is a superset of covered_, so a run with nothing new
+	// against covered_ is done after a single pass of wide compares.
+	bool found_new_bucket = false;
+	if ((n > 0) && HasNewCoverage(&hits.front(), &covered_.front(), n)) {
+		for (size_t i = 1; i < n; i++) {
+			if (!(hits[i] & ~covered_[i]))
+				continue;
+			found_new_bucket = true;
+			branch_id_t bid = static_cast<branch_id_t>(i);
+			if (!covered_[i]) {
+				num_covered_++;
+				if (new_branches) {
+					new_branches->insert(bid);
+				}
+				if (!reached_[branch_function_[bid]]) {
+					reached_[branch_function_[bid]] = true;
+					reachable_functions_ ++;
+					reachable_branches_ += branch_count_[branch_function_[bid]];
+				}
 			}
-			if (!reached_[branch_function_[*i]]) {
-				reached_[branch_function_[*i]] = true;
-				reachable_functions_ ++;
-				reachable_branches_ += branch_count_[branch_function_[*i]];
+			covered_[i] |= hits[i];
+			if (!total_covered_[i]) {
+				total_num_covered_++;
+				new_total.push_back(bid);
 			}
-		}
-		if ((*i > 0) && !total_covered_[*i]) {
-			total_covered_[*i] = true;
-			total_num_covered_++;
+			total_covered_[i] |= hits[i];
 		}
 	}
 	fprintf(stderr, "Iteration %d (%lds, %ld.%lds): covered %u branches [%u reach funs, %u reach branches].(%u, %u)\n",
 			num_iters_, time(NULL)-start_time_, Z3Solver::GetRunningTime() / 1000, Z3Solver::GetRunningTime() % 1000,
 			total_num_covered_, reachable_functions_, reachable_branches_, num_covered_, prev_covered_);
+	if (Z3Solver::unknown_count_) {
+		fprintf(stderr, "  solver unknown: %zu queries, %ld.%03lds lost\n",
+				Z3Solver::unknown_count_, Z3Solver::unknown_time_ / 1000,
+				Z3Solver::unknown_time_ % 1000);
+	}
 #if 0
 	{
 		fprintf(stderr, "Reduction SAT count: %u, ", Z3Solver::reduction_sat_count);
@@ -454,12 +625,14 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex,
 
 	}
 #endif
-	bool found_new_branch = (num_covered_ > prev_covered_);
-	if (found_new_branch) {
-		WriteCoverageToFileOrDie("coverage");
+	if (!new_total.empty()) {
+		AppendCoverageToFileOrDie("coverage", new_total);
 	}
 
-	return found_new_branch;
+	if (new_bucket) {
+		*new_bucket = found_new_bucket;
+	}
+	return (num_covered_ > prev_covered_);
 }
 
 
@@ -520,25 +693,9 @@ bool Search::SolveAtBranch(SymbolicExecution& ex,
 		size_t branch_idx,
 		vector<Value_t>* input) {
 	global_tracker_ = ex.object_tracker();
-	const vector<SymbolicExpr*>& constraints = ex.path().constraints();
-
-	// Optimization: If any of the previous constraints are idential to the
-	// branch_idx-th constraint, immediately return false.
-	// Commenting out for time-being
-/*
-	for (int i = static_cast<int>(branch_idx) - 1; i >= 0; i--) {
-		if (constraints[branch_idx]->Equals(*constraints[i]))
-			return false;
-	}
-*/
-	vector<const SymbolicExpr*> cs(constraints.begin(),
-			constraints.begin()+branch_idx+1);
+	vector<const SymbolicExpr*> cs;
+	NegatedQuery(ex, branch_idx, &cs);
 	map<var_t,Value_t> soln;
-	//constraints[branch_idx]->Negate();
-	SymbolicExpr *tempExpr = constraints[branch_idx];
-	Value_t tempVal = Value_t(1 - tempExpr->value().integral, (double) (1 - tempExpr->value().floating), tempExpr->value().type);
-	cs[branch_idx] = new UnaryExpr(ops::LOGICAL_NOT, tempExpr, kSizeOfType[tempVal.type], tempVal);
-//SymbolicExprFactory::NewUnaryExpr(tempVal, ops::LOGICAL_NOT, tempExpr);
 
 #ifdef DEBUG
 	for (size_t i = 0; i < ex.inputs().size(); i++) {
@@ -547,36 +704,266 @@ bool Search::SolveAtBranch(SymbolicExecution& ex,
 #endif
 
 	//TODO: Implement IncrementalSolve
-	bool success = Z3Solver::Solve(ex.vars(),ex.values(),ex.h(), ex.l(), ex.exprs(), cs, &soln);
+	bool success = false, unsat = false;
+	branch_id_t target = FlipTarget(ex, branch_idx);
+	if (SolveWithoutZ3(ex, branch_idx, cs, &soln, &success, &unsat)) {
+		// Answered without Z3.
+	} else if (IsSolverDemoted(target)) {
+		demoted_queries_++;
+	} else {
+		z3_queries_++;
+		vector<size_t> core;
+		success = Z3Solver::Solve(ex.vars(),ex.values(),ex.h(), ex.l(), ex.exprs(), cs, &soln,
+				1u << solver_unknowns_[target], &core,
+				flag_preserve_inputs ? &ex.inputs() : NULL);
+		RecordZ3Answer(ex, branch_idx, success, Z3Solver::last_unknown_, core, soln);
+	}
 	//bool success = Z3Solver::IncrementalSolve(ex.inputs(), ex.vars(), cs, &soln);
 	//constraints[branch_idx]->Negate();
 
-//printf("ex tracker %d\n", ex.object_tracker2()->snapshotManager().size());
-	//Init isCreateAST
-	size_t managerSize = global_tracker_->astManager().size();
-	for(size_t iter = 0; iter < managerSize; iter++){
-		size_t objSize = global_tracker_->astManager()[iter]->size();
-		for(size_t iter2 = 0; iter2 < objSize; iter2++){
-			global_tracker_->isCreateAST()[iter]->at(iter2) = false;
+	ResetCreatedASTs();
+
+	if (success) {
+		MergeSolution(ex, soln, input);
+		return true;
+	}
+
+	return false;
+}
+
+
+void Search::SolveAtBranches(SymbolicExecution& ex,
+		const vector<size_t>& branch_idxs,
+		vector<vector<Value_t> >* inputs,
+		vector<bool>* solved) {
+	global_tracker_ = ex.object_tracker();
+	inputs->assign(branch_idxs.size(), vector<Value_t>());
+	solved->assign(branch_idxs.size(), false);
+
+	// Cheap stages first, one flip at a time; what is left goes to Z3 in
+	// one batch.
+	vector<Z3Solver::BatchQuery> queries;
+	vector<size_t> query_pos;
+	for (size_t k = 0; k < branch_idxs.size(); k++) {
+		size_t branch_idx = branch_idxs[k];
+		vector<const SymbolicExpr*> cs;
+		NegatedQuery(ex, branch_idx, &cs);
+		map<var_t,Value_t> soln;
+		bool success = false, unsat = false;
+		branch_id_t target = FlipTarget(ex, branch_idx);
+		if (SolveWithoutZ3(ex, branch_idx, cs, &soln, &success, &unsat)) {
+			if (success) {
+				MergeSolution(ex, soln, &(*inputs)[k]);
+				(*solved)[k] = true;
+			}
+		} else if (IsSolverDemoted(target)) {
+			demoted_queries_++;
+		} else {
+			Z3Solver::BatchQuery q;
+			q.index = branch_idx;
+			q.limit_scale = 1u << solver_unknowns_[target];
+			queries.push_back(q);
+			query_pos.push_back(k);
+		}
+	}
+
+	z3_queries_ += queries.size();
+	Z3Solver::SolveBatch(ex.vars(), ex.values(), ex.h(), ex.l(), ex.exprs(),
+			ex.path().constraints(), &queries,
+			flag_preserve_inputs ? &ex.inputs() : NULL);
+	for (size_t q = 0; q < queries.size(); q++) {
+		const Z3Solver::BatchQuery& bq = queries[q];
+		RecordZ3Answer(ex, bq.index, bq.sat, bq.unknown, bq.core, bq.soln);
+		if (bq.sat) {
+			MergeSolution(ex, bq.soln, &(*inputs)[query_pos[q]]);
+			(*solved)[query_pos[q]] = true;
 		}
 	}
 
+	ResetCreatedASTs();
+}
+
+
+void Search::NegatedQuery(const SymbolicExecution& ex, size_t branch_idx,
+		vector<const SymbolicExpr*>* cs) {
+	const vector<SymbolicExpr*>& constraints = ex.path().constraints();
+
+	// Duplicated and contradictory constraints are caught by
+	// SyntacticCheck.
+	cs->assign(constraints.begin(), constraints.begin()+branch_idx+1);
+	//constraints[branch_idx]->Negate();
+	SymbolicExpr *tempExpr = constraints[branch_idx];
+	Value_t tempVal = Value_t(1 - tempExpr->value().integral, (double) (1 - tempExpr->value().floating), tempExpr->value().type);
+	(*cs)[branch_idx] = new UnaryExpr(ops::LOGICAL_NOT, tempExpr, kSizeOfType[tempVal.type], tempVal);
+//SymbolicExprFactory::NewUnaryExpr(tempVal, ops::LOGICAL_NOT, tempExpr);
+}
+
+
+branch_id_t Search::FlipTarget(const SymbolicExecution& ex, size_t branch_idx) const {
+	return paired_branch_[ex.path().branches()[ex.path().constraints_idx()[branch_idx]]];
+}
+
+
+bool Search::SolveWithoutZ3(const SymbolicExecution& ex, size_t branch_idx,
+		const vector<const SymbolicExpr*>& cs, map<var_t,Value_t>* soln,
+		bool* success, bool* unsat) {
+	*success = *unsat = false;
+	syntactic_queries_++;
+	switch (SyntacticCheck::Check(ex.vars(), ex.inputs(), cs, soln)) {
+		case SyntacticCheck::UNSAT:
+			syntactic_unsat_++;
+			*unsat = true;
+			break;
+		case SyntacticCheck::SAT:
+			syntactic_sat_++;
+			*success = true;
+			break;
+		case SyntacticCheck::UNKNOWN:
+			if (MatchesUnsatCore(ex, branch_idx)) {
+				core_hits_++;
+				*unsat = true;
+			} else {
+				*success = SolveFromModelCache(ex, cs, soln);
+			}
+			break;
+	}
+	if (!*success && !*unsat && flag_fp_local_search) {
+		*success = FPLocalSearch::Solve(ex.vars(), ex.inputs(), cs, soln);
+	}
+	return (*success || *unsat);
+}
+
+
+void Search::RecordZ3Answer(const SymbolicExecution& ex, size_t branch_idx,
+		bool success, bool unknown, const vector<size_t>& core,
+		const map<var_t,Value_t>& soln) {
+	if (unknown)
+		solver_unknowns_[FlipTarget(ex, branch_idx)]++;
+	else if (!success)
+		RecordUnsatCore(ex, branch_idx, core);
 	if (success) {
-		// Merge the solution with the previous input to get the next
-		// input.  (Could merge with random inputs, instead.)
-		*input = ex.inputs();
-		// RandomInput(ex.vars(), input);
-
-		typedef map<var_t,Value_t>::const_iterator SolnIt;
-		for (SolnIt i = soln.begin(); i != soln.end(); ++i) {
-			(*input)[i->first] = i->second;
+		z3_solved_++;
+		model_cache_.push_front(soln);
+		if (model_cache_.size() > kModelCacheSize)
+			model_cache_.pop_back();
+	}
+}
+
+
+void Search::ResetCreatedASTs() {
+	global_tracker_->ResetASTs();
+}
+
+
+void Search::MergeSolution(const SymbolicExecution& ex,
+		const map<var_t,Value_t>& soln, vector<Value_t>* input) {
+	// Merge the solution with the previous input to get the next
+	// input.  (Could merge with random inputs, instead.)
+	*input = ex.inputs();
+	// RandomInput(ex.vars(), input);
+
+	typedef map<var_t,Value_t>::const_iterator SolnIt;
+	for (SolnIt i = soln.begin(); i != soln.end(); ++i) {
+		(*input)[i->first] = i->second;
+	}
+}
+
+bool Search::SolveFromModelCache(const SymbolicExecution& ex,
+		const vector<const SymbolicExpr*>& cs, map<var_t,Value_t>* soln) {
+	if (model_cache_.empty())
+		return false;
+
+	Assignment base;
+	for (size_t i = 0; i < ex.inputs().size(); i++)
+		base[i] = ex.inputs()[i];
+
+	cache_queries_++;
+	for (size_t m = 0; m < model_cache_.size(); m++) {
+		Assignment a = base;
+		map<var_t,Value_t> overlay;
+		const map<var_t,Value_t>& model = model_cache_[m];
+		for (map<var_t,Value_t>::const_iterator i = model.begin(); i != model.end(); ++i) {
+			map<var_t,type_t>::const_iterator v = ex.vars().find(i->first);
+			// A bitfield value also holds the neighbouring fields that
+			// were pinned for that model's execution, not this one.
+			if (v != ex.vars().end() && v->second == i->second.type
+					&& v->second < types::BITFIELD_CHAR) {
+				a[i->first] = i->second;
+				overlay.insert(*i);
+			}
+		}
+		if (!overlay.empty() && SymbolicExpr::IsSatisfiedBy(cs, a)) {
+			cache_hits_++;
+			soln->swap(overlay);
+			return true;
 		}
-		return true;
 	}
+	return false;
+}
+
+bool Search::MatchesUnsatCore(const SymbolicExecution& ex, size_t branch_idx) {
+	const SymbolicPath& path = ex.path();
+	branch_id_t bid = path.branches()[path.constraints_idx()[branch_idx]];
+	const std::deque<UnsatCore>& cores = unsat_cores_[bid];
 
+	for (size_t k = 0; k < cores.size(); k++) {
+		const UnsatCore& core = cores[k];
+		size_t last = core.exprs.size() - 1;
+		if (!SyntacticCheck::SameExpr(core.exprs[last], path.constraints()[branch_idx]))
+			continue;
+		bool found_all = true;
+		for (size_t m = 0; m < last && found_all; m++) {
+			found_all = false;
+			for (size_t i = 0; i < branch_idx; i++) {
+				if (path.branches()[path.constraints_idx()[i]] == core.bids[m]
+						&& SyntacticCheck::SameExpr(core.exprs[m], path.constraints()[i])) {
+					found_all = true;
+					break;
+				}
+			}
+		}
+		if (found_all)
+			return true;
+	}
 	return false;
 }
 
+
+void Search::RecordUnsatCore(const SymbolicExecution& ex, size_t branch_idx,
+		const vector<size_t>& core) {
+	// Only cores that involve the negated branch say anything about it.
+	if (core.empty() || core.back() != branch_idx)
+		return;
+
+	// Nor can cores that SameExpr will never match (dereferences).
+	const SymbolicPath& path = ex.path();
+	for (size_t i = 0; i < core.size(); i++) {
+		const SymbolicExpr* e = path.constraints()[core[i]];
+		if (!SyntacticCheck::SameExpr(e, e))
+			return;
+	}
+
+	UnsatCore c;
+	for (size_t i = 0; i < core.size(); i++) {
+		c.bids.push_back(path.branches()[path.constraints_idx()[core[i]]]);
+		c.exprs.push_back(path.constraints()[core[i]]->Clone());
+	}
+
+	std::deque<UnsatCore>& cores = unsat_cores_[c.bids.back()];
+	cores.push_front(c);
+	if (cores.size() > kMaxCoresPerBranch) {
+		FreeUnsatCore(&cores.back());
+		cores.pop_back();
+	}
+}
+
+
+void Search::FreeUnsatCore(UnsatCore* core) {
+	for (size_t i = 0; i < core->exprs.size(); i++)
+		delete core->exprs[i];
+	core->exprs.clear();
+}
+
 #if 0
 bool Search::CheckPrediction(const SymbolicExecution& old_ex,
 		const SymbolicExecution& new_ex,
@@ -611,18 +998,25 @@ bool Search::CheckPrediction(const SymbolicExecution& old_ex,
 					const SymbolicExecution& new_ex,
 					size_t branch_idx) {
 
+	predictions_++;
 	if ((old_ex.path().branches().size() <= branch_idx)
 			|| (new_ex.path().branches().size() <= branch_idx)) {
+		failed_predictions_++;
 		return false;
 	}
 
 	for (size_t j = 0; j < branch_idx; j++) {
 		if  (new_ex.path().branches()[j] != old_ex.path().branches()[j]) {
+			failed_predictions_++;
 			return false;
 		}
 	}
-	return (new_ex.path().branches()[branch_idx]
-			!= old_ex.path().branches()[branch_idx]);
+	if (new_ex.path().branches()[branch_idx]
+			== old_ex.path().branches()[branch_idx]) {
+		failed_predictions_++;
+		return false;
+	}
+	return true;
 }
 #endif
 
@@ -650,15 +1044,40 @@ void BoundedDepthFirstSearch::Run() {
 
 }
 
+// Solves the flip order[k] of ex.  The flips are sent to the solver in
+// batches of up to kBatchSize, but no more than the depth left, since
+// each success uses up one.
+bool BoundedDepthFirstSearch::SolveInBatch(SymbolicExecution& ex,
+		const vector<size_t>& order, size_t k, int depth,
+		FlipBatch* batch, vector<Value_t>* input) {
+	if (batch->solved.empty() || k >= batch->start + batch->solved.size()) {
+		size_t n = std::min(order.size() - k,
+				std::min((size_t)depth, (size_t)kBatchSize));
+		vector<size_t> idxs(order.begin() + k, order.begin() + k + n);
+		batch->start = k;
+		SolveAtBranches(ex, idxs, &batch->inputs, &batch->solved);
+	}
+	size_t j = k - batch->start;
+	if (!batch->solved[j])
+		return false;
+	input->swap(batch->inputs[j]);
+	return true;
+}
+
 void BoundedDepthFirstSearch::reverse_DFS(size_t pos, int depth, SymbolicExecution& prev_ex) {
 	SymbolicExecution cur_ex;
 	vector<Value_t> input;
 
 	const SymbolicPath& path = prev_ex.path();
 
-	for (size_t i = pos; (i < path.constraints().size()) && (depth > 0); i++) {
+	vector<size_t> order;
+	for (size_t i = pos; i < path.constraints().size(); i++)
+		order.push_back(i);
+	FlipBatch batch;
+	for (size_t k = 0; (k < order.size()) && (depth > 0); k++) {
+		size_t i = order[k];
 		// Solve constraints[0..i].
-		if (!SolveAtBranch(prev_ex, i, &input)) {
+		if (!SolveInBatch(prev_ex, order, k, depth, &batch, &input)) {
 			Z3Solver::no_reduction_unsat_formula_length += (i+1);
 			Z3Solver::no_reduction_unsat_count++;
 
@@ -669,7 +1088,7 @@ void BoundedDepthFirstSearch::reverse_DFS(size_t pos, int depth, SymbolicExecuti
 	
 		SymbolicExecution* ex = new SymbolicExecution();	
 		cur_ex = *ex;
-		assert(cur_ex.object_tracker()->snapshotManager().size()==0);
+		assert(cur_ex.object_tracker()->managerSize()==0);
 
 		// Run on those constraints.
 		cur_ex = SymbolicExecution();
@@ -698,9 +1117,14 @@ void BoundedDepthFirstSearch::DFS(size_t pos, int depth, SymbolicExecution& prev
 
 	const SymbolicPath& path = prev_ex.path();
 
-	for (size_t i = path.constraints().size()-1; i < path.constraints().size() && i>=pos && (depth > 0); i--) {
+	vector<size_t> order;
+	for (size_t i = path.constraints().size(); i-- > pos; )
+		order.push_back(i);
+	FlipBatch batch;
+	for (size_t k = 0; k < order.size() && (depth > 0); k++) {
+		size_t i = order[k];
 		// Solve constraints[0..i].
-		if (!SolveAtBranch(prev_ex, i, &input)) {
+		if (!SolveInBatch(prev_ex, order, k, depth, &batch, &input)) {
 			Z3Solver::no_reduction_unsat_formula_length += (i+1);
 			Z3Solver::no_reduction_unsat_count++;
 
@@ -711,7 +1135,7 @@ void BoundedDepthFirstSearch::DFS(size_t pos, int depth, SymbolicExecution& prev
 	
 		SymbolicExecution* ex = new SymbolicExecution();	
 		cur_ex = *ex;
-		assert(cur_ex.object_tracker()->snapshotManager().size()==0);
+		assert(cur_ex.object_tracker()->managerSize()==0);
 
 		// Run on those constraints.
 		cur_ex = SymbolicExecution();
@@ -739,9 +1163,16 @@ void BoundedDepthFirstSearch::DFS(size_t pos, int depth, SymbolicExecution& prev
 ////////////////////////////////////////////////////////////////////////
 
 RandomInputSearch::RandomInputSearch(const string& program, int max_iterations)
-	: Search(program, max_iterations) { }
+	: Search(program, max_iterations) {
+	// Random inputs only need coverage, so tell libcrown to skip building
+	// symbolic expressions and parse just the inputs and branches.
+	branch_only_ = true;
+	setenv("CROWN_BRANCH_ONLY", "1", 1);
+}
 
-RandomInputSearch::~RandomInputSearch() { }
+RandomInputSearch::~RandomInputSearch() {
+	unsetenv("CROWN_BRANCH_ONLY");
+}
 
 void RandomInputSearch::Run() {
 	vector<Value_t> input;
@@ -787,7 +1218,9 @@ void RandomSearch::Run() {
 			if (SolveRandomBranch(&next_input, &idx)) {
 				next_ex = SymbolicExecution();
 				RunProgram(next_input, &next_ex);
-				bool found_new_branch = UpdateCoverage(next_ex);
+				bool found_new_bucket;
+				bool found_new_branch =
+					UpdateCoverage(next_ex, NULL, &found_new_bucket);
 				bool prediction_failed =
 					!CheckPrediction(ex_, next_ex, ex_.path().constraints_idx()[idx]);
 
@@ -796,7 +1229,9 @@ void RandomSearch::Run() {
 					ex_.Swap(next_ex);
 					if (prediction_failed)
 						fprintf(stderr, "Prediction failed (but got lucky).\n");
-				} else if (!prediction_failed) {
+				} else if (!prediction_failed || found_new_bucket) {
+					// A path that runs some branch a new number of times
+					// (by hit-count bucket) is also worth exploring from.
 					ex_.Swap(next_ex);
 				} else {
 					fprintf(stderr, "Prediction failed.\n");
@@ -1131,7 +1566,7 @@ void CfgHeuristicSearch::Run() {
 	SymbolicExecution ex;
 
 	while (true) {
-		covered_.assign(max_branch_, false);
+		covered_.assign(covered_.size(), 0);
 		num_covered_ = 0;
 
 		// Execution on empty/random inputs.
@@ -11,11 +11,15 @@
 #ifndef RUN_CROWN_CONCOLIC_SEARCH_H__
 #define RUN_CROWN_CONCOLIC_SEARCH_H__
 
+#include <deque>
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 #include <ext/hash_map>
 #include <ext/hash_set>
 #include <time.h>
+#include <stdio.h>
 
 /*
 #include <sys/types.h>
@@ -44,8 +48,12 @@ class Search {
 	 vector<branch_id_t> branches_;
 	 vector<branch_id_t> paired_branch_;
 	 vector<function_id_t> branch_function_;
-	 vector<bool> covered_;
-	 vector<bool> total_covered_;
+	 // One byte per branch id holding the union of the hit-count buckets
+	 // seen for it (0 if uncovered), padded to a multiple of
+	 // kCoverageMapAlign so they can be compared a word at a time
+	 // against the bucketed hit counts of an execution.
+	 vector<unsigned char> covered_;
+	 vector<unsigned char> total_covered_;
 	 branch_id_t max_branch_;
 	 unsigned int num_covered_;
 	 unsigned int total_num_covered_;
@@ -60,12 +68,23 @@ class Search {
 
 	 time_t start_time_;
 
+	 // Only branch ids are recorded/parsed (see CROWN_BRANCH_ONLY).
+	 bool branch_only_;
+
 	 typedef vector<branch_id_t>::const_iterator BranchIt;
 
 	 bool SolveAtBranch(SymbolicExecution& ex,
 			 size_t branch_idx,
 			 vector<Value_t>* input);
 
+	 // Solves the flips of several branches of one path, sending the ones
+	 // the cheap solvers cannot answer to Z3 in one batch.  (*inputs)[k]
+	 // is the next input for branch_idxs[k] if (*solved)[k].
+	 void SolveAtBranches(SymbolicExecution& ex,
+			 const vector<size_t>& branch_idxs,
+			 vector<vector<Value_t> >* inputs,
+			 vector<bool>* solved);
+
 	 bool CheckPrediction(const SymbolicExecution& old_ex,
 			 const SymbolicExecution& new_ex,
 			 size_t branch_idx);
@@ -74,9 +93,18 @@ class Search {
 	 bool UpdateCoverage(const SymbolicExecution& ex);
 	 bool UpdateCoverage(const SymbolicExecution& ex,
 			 set<branch_id_t>* new_branches);
+	 // As above; also sets *new_bucket if some branch reached a hit-count
+	 // bucket it had never reached before (AFL-style novelty).
+	 bool UpdateCoverage(const SymbolicExecution& ex,
+			 set<branch_id_t>* new_branches, bool* new_bucket);
 
 	 void RandomInput(const map<var_t,type_t>& vars, vector<Value_t>* input);
 
+	 // Whether Z3 is no longer tried for branch b (see solver_unknowns_).
+	 bool IsSolverDemoted(branch_id_t b) const {
+		 return solver_unknowns_[b] >= kMaxSolverUnknowns;
+	 }
+
  private:
 	 const string program_;
 	 const int max_iters_;
@@ -89,7 +117,85 @@ class Search {
 
 	 void WriteInputToFileOrDie(const string& file, const vector<Value_t>& input, const vector<unsigned char> & h, const vector<unsigned char> & l,
 					 												const vector<unsigned char> & idx);
+	 void SerializeInput(const vector<Value_t>& input, const vector<unsigned char>& h,
+			 const vector<unsigned char>& l, const vector<unsigned char>& idx, string* out);
+	 void WriteBufferToFileOrDie(const string& file, const string& buf);
+
+	 // Test cases for TCdir are appended to one pack file (and its index)
+	 // that stays open for the whole search (see TestCaseIndex).
+	 FILE* tc_pack_;
+	 FILE* tc_index_;
+	 unsigned long long tc_pack_size_;
+	 void AppendTestCaseOrDie(const string& buf);
+	 void CloseTestCasesOrDie();
+
+	 // Number of queries sent to Z3, and how many were satisfiable.
+	 size_t z3_queries_;
+	 size_t z3_solved_;
+	 void PrintSolverStats();
+
+	 // Number of UNKNOWN answers from Z3 for each target branch.  Each
+	 // retry doubles the solver limits; after kMaxSolverUnknowns the
+	 // branch is demoted and only the cheap solvers are tried.
+	 static const unsigned char kMaxSolverUnknowns = 3;
+	 vector<unsigned char> solver_unknowns_;
+	 size_t demoted_queries_;
+
+	 // Cores of UNSAT flips: the branches taken and their constraints,
+	 // ending with the branch whose negation made the query UNSAT.  A
+	 // later flip of that branch is skipped if its prefix contains every
+	 // other member of a core for it.
+	 struct UnsatCore {
+		 vector<branch_id_t> bids;
+		 vector<SymbolicExpr*> exprs;
+	 };
+	 static const size_t kMaxCoresPerBranch = 16;
+	 vector<std::deque<UnsatCore> > unsat_cores_;
+	 size_t core_hits_;
+	 bool MatchesUnsatCore(const SymbolicExecution& ex, size_t branch_idx);
+	 void RecordUnsatCore(const SymbolicExecution& ex, size_t branch_idx,
+			 const vector<size_t>& core);
+	 static void FreeUnsatCore(UnsatCore* core);
+
+	 // Pieces of SolveAtBranch(es).
+	 void NegatedQuery(const SymbolicExecution& ex, size_t branch_idx,
+			 vector<const SymbolicExpr*>* cs);
+	 branch_id_t FlipTarget(const SymbolicExecution& ex, size_t branch_idx) const;
+	 bool SolveWithoutZ3(const SymbolicExecution& ex, size_t branch_idx,
+			 const vector<const SymbolicExpr*>& cs, map<var_t,Value_t>* soln,
+			 bool* success, bool* unsat);
+	 void RecordZ3Answer(const SymbolicExecution& ex, size_t branch_idx,
+			 bool success, bool unknown, const vector<size_t>& core,
+			 const map<var_t,Value_t>& soln);
+	 void ResetCreatedASTs();
+	 void MergeSolution(const SymbolicExecution& ex,
+			 const map<var_t,Value_t>& soln, vector<Value_t>* input);
+
+	 // Predictions checked by CheckPrediction, and how many failed (each
+	 // failure is a wasted execution).
+	 size_t predictions_;
+	 size_t failed_predictions_;
+
+	 // Queries answered by SyntacticCheck without a solver.
+	 size_t syntactic_queries_;
+	 size_t syntactic_unsat_;
+	 size_t syntactic_sat_;
+
+	 // Recent Z3 models, checked with SymbolicExpr::Evaluate before a
+	 // query is sent to Z3.
+	 static const size_t kModelCacheSize = 8;
+	 std::deque<map<var_t,Value_t> > model_cache_;
+	 size_t cache_queries_;
+	 size_t cache_hits_;
+	 bool SolveFromModelCache(const SymbolicExecution& ex,
+			 const vector<const SymbolicExpr*>& cs, map<var_t,Value_t>* soln);
 	 void WriteCoverageToFileOrDie(const string& file);
+	 void AppendCoverageToFileOrDie(const string& file,
+			 const vector<branch_id_t>& bids);
+
+	 // Coverage is logged append-only while searching, and compacted
+	 // (rewritten in sorted order) when the search finishes.
+	 FILE* coverage_file_;
 	 int LaunchProgram(const vector<Value_t>& inputs);
 	 int LaunchProgram();
 };
@@ -111,6 +217,15 @@ private:
 	//reverse set to 1 for reverse DFS
 	//reverse set to 0 for DFS
 
+	static const size_t kBatchSize = 8;
+	struct FlipBatch {
+		size_t start;
+		vector<vector<Value_t> > inputs;
+		vector<bool> solved;
+	};
+	bool SolveInBatch(SymbolicExecution& ex, const vector<size_t>& order,
+			size_t k, int depth, FlipBatch* batch, vector<Value_t>* input);
+
 	void reverse_DFS(size_t pos, int depth, SymbolicExecution& prev_ex);
 	void DFS(size_t pos, int depth, SymbolicExecution& prev_ex);
 };
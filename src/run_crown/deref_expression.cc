@@ -48,9 +48,9 @@ DerefExpr* DerefExpr::Clone() const {
 
 void DerefExpr::AppendVars(set<var_t>* vars) const {
 	ObjectTracker* tracker = global_tracker_;
-	assert(tracker->snapshotManager().size() > managerIdx_);
-	assert(tracker->snapshotManager()[managerIdx_]->size() > snapshotIdx_);
-	SymbolicObject*	object = tracker->snapshotManager()[managerIdx_]->at(snapshotIdx_);
+	assert(tracker->managerSize() > managerIdx_);
+	assert(tracker->snapshotCount(managerIdx_) > snapshotIdx_);
+	SymbolicObject*	object = tracker->snapshot(managerIdx_, snapshotIdx_);
 	addr_->AppendVars(vars);
 
 	for(size_t i = 0; i < object->writes().size(); i++){
@@ -63,9 +63,9 @@ void DerefExpr::AppendVars(set<var_t>* vars) const {
 
 bool DerefExpr::DependsOn(const map<var_t,type_t>& vars) const {
 	ObjectTracker* tracker = global_tracker_;
-	assert(tracker->snapshotManager().size() > managerIdx_);
-	assert(tracker->snapshotManager()[managerIdx_]->size() > snapshotIdx_);
-	SymbolicObject*	object = tracker->snapshotManager()[managerIdx_]->at(snapshotIdx_);
+	assert(tracker->managerSize() > managerIdx_);
+	assert(tracker->snapshotCount(managerIdx_) > snapshotIdx_);
+	SymbolicObject*	object = tracker->snapshot(managerIdx_, snapshotIdx_);
 
 	for(size_t i = 0; i < object->writes().size(); i++){
 		SymbolicExpr *index = object->writes()[i].first;
@@ -98,26 +98,9 @@ Z3_ast DerefExpr::ConvertToSMT(Z3_context ctx, Z3_solver sol) const {
 	Value_t value_ = value();
 	ObjectTracker* tracker = global_tracker_;
 
-	assert(tracker->snapshotManager().size() > managerIdx_);
-	assert(tracker->snapshotManager()[managerIdx_]->size() > snapshotIdx_);
-	SymbolicObject*	object = tracker->snapshotManager()[managerIdx_]->at(snapshotIdx_);
-
-	//If the snapshots are not created as a SMT, then create dummy SMT
-	if(tracker->isASTInit == false){
-		char name[24] = "t0";
-		Z3_sort ty = Z3_mk_bv_sort(ctx, 32);
-		Z3_ast con = Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, name), ty);
-
-		for(size_t iter = 0; iter < tracker->snapshotManager().size(); iter++){
-			size_t objSize = tracker->snapshotManager()[iter]->size();
-			for(size_t iter2 = 0; iter2 < objSize; iter2++){
-				tracker->astManager()[iter]->push_back(con);
-				tracker->isCreateAST()[iter]->push_back(false);
-			}
-		}
-		tracker->isASTInit = true;
-	}
-
+	assert(tracker->managerSize() > managerIdx_);
+	assert(tracker->snapshotCount(managerIdx_) > snapshotIdx_);
+	SymbolicObject*	object = tracker->snapshot(managerIdx_, snapshotIdx_);
 
 	//size_t mem_length = object->writes().size();
 	//Naming the uninterpreted function
@@ -144,12 +127,9 @@ Z3_ast DerefExpr::ConvertToSMT(Z3_context ctx, Z3_solver sol) const {
 	Z3_ast array = Z3_mk_const(ctx, array_symbol, array_sort);
 
 	//If the object isn't already created as SMT, then create it. 
-	if(tracker->isCreateAST()[managerIdx_]->at(snapshotIdx_) == false){
+	if(!tracker->FindAST(managerIdx_, snapshotIdx_, &array)){
 		array = object->ConvertToSMT(ctx, sol, array, output_type);
-		tracker->astManager()[managerIdx_]->at(snapshotIdx_) = array;
-		tracker->isCreateAST()[managerIdx_]->at(snapshotIdx_) = true;
-	}else{
-		array = tracker->astManager()[managerIdx_]->at(snapshotIdx_);
+		tracker->SetAST(managerIdx_, snapshotIdx_, array);
 	}
 
 	//Dereference has to be in array (e.g. a[4] -> index can be 0,1,2,3)
@@ -169,6 +149,54 @@ Z3_ast DerefExpr::ConvertToSMT(Z3_context ctx, Z3_solver sol) const {
 	return tmp;
 }
 
+bool DerefExpr::Evaluate(const Assignment& a, Value_t* out) const {
+	ObjectTracker* tracker = global_tracker_;
+	if (tracker == NULL
+			|| tracker->managerSize() <= managerIdx_
+			|| tracker->snapshotCount(managerIdx_) <= snapshotIdx_)
+		return false;
+	SymbolicObject*	object = tracker->snapshot(managerIdx_, snapshotIdx_);
+
+	Value_t addr;
+	if (!addr_->Evaluate(a, &addr))
+		return false;
+	size_t asize = addr_->size();
+	value_t target = Truncate(addr.integral, asize, false);
+	value_t concrete = Truncate(addr_->value().integral, asize, false);
+
+	// The last write to the address wins.  If a write hit the address
+	// on the concrete run but not under a, the memory under it is
+	// unknown.
+	bool concretely_written = false;
+	for (size_t i = object->writes().size(); i-- > 0; ) {
+		const SymbolicExpr* index = object->writes()[i].first;
+		const SymbolicExpr* exp = object->writes()[i].second;
+		Value_t idx;
+		if (!index->Evaluate(a, &idx))
+			return false;
+		if (Truncate(idx.integral, index->size(), false) == target) {
+			Value_t v;
+			if (!exp->Evaluate(a, &v))
+				return false;
+			if (IsFloatType(value().type)) {
+				*out = MakeFloatValue(v.floating);
+			} else {
+				*out = MakeValue(Truncate(v.integral, exp->size(),
+							IsSignedType(exp->value().type)));
+			}
+			return true;
+		}
+		if (Truncate(index->value().integral, index->size(), false) == concrete)
+			concretely_written = true;
+	}
+
+	// Unwritten memory is only known at the concretely accessed address.
+	if (target != concrete || concretely_written)
+		return false;
+	*out = value();
+	return true;
+}
+
 bool DerefExpr::Equals(const SymbolicExpr& e) const {
 	const DerefExpr* d = e.CastDerefExpr();
 	return ((d != NULL)
@@ -37,6 +37,7 @@ public:
 	bool IsConcrete() const { return false; }
 
 	Z3_ast ConvertToSMT(Z3_context ctx, Z3_solver sol) const;
+	bool Evaluate(const Assignment& a, Value_t* out) const;
 
 	const DerefExpr* CastDerefExpr() const { return this; }
 
@@ -46,6 +47,8 @@ public:
 	const size_t snapshotIdx_;
 
 private:
+	friend class SymbolicExprSimplifier;
+
 	// The symbolic object corresponding to the dereference.
 	SymbolicObject *object_;
 
@@ -0,0 +1,238 @@
+// This file is part of CROWN, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <cfloat>
+#include <cmath>
+#include <set>
+#include <utility>
+
+#include "run_crown/fp_local_search.h"
+#include "run_crown/unary_expression.h"
+#include "run_crown/bin_expression.h"
+#include "run_crown/pred_expression.h"
+
+using std::make_pair;
+using std::set;
+
+namespace crown {
+
+size_t FPLocalSearch::num_queries_ = 0;
+size_t FPLocalSearch::num_solved_ = 0;
+
+namespace {
+
+double ToDouble(const Value_t& v) {
+	return SymbolicExpr::IsFloatType(v.type) ? v.floating : (double)v.integral;
+}
+
+bool Compare(compare_op_t op, double l, double r) {
+	switch (op) {
+		case ops::EQ:  return l == r;
+		case ops::NEQ: return l != r;
+		case ops::GT: case ops::S_GT: return l > r;
+		case ops::LE: case ops::S_LE: return l <= r;
+		case ops::LT: case ops::S_LT: return l < r;
+		case ops::GE: case ops::S_GE: return l >= r;
+	}
+	return false;
+}
+
+// How far a constraint that does not hold is from holding.  Only used
+// to guide the search; whether it holds comes from Evaluate.
+double Distance(const SymbolicExpr* e, bool negate, const Assignment& asgn) {
+	if (const PredExpr* p = e->CastPredExpr()) {
+		Value_t l, r;
+		if (!p->left()->Evaluate(asgn, &l) || !p->right()->Evaluate(asgn, &r))
+			return DBL_MAX;
+		double x = ToDouble(l), y = ToDouble(r);
+		compare_op_t op = negate ? NegateCompareOp(p->compare_op()) : p->compare_op();
+		if (std::isnan(x) || std::isnan(y))
+			return DBL_MAX;
+		if (op == ops::NEQ || Compare(op, x, y))
+			return 1;
+		double d = fabs(x - y) + DBL_MIN;
+		return std::isinf(d) ? DBL_MAX : d;
+	}
+
+	const UnaryExpr* u = e->CastUnaryExpr();
+	if (u && u->unary_op() == ops::LOGICAL_NOT)
+		return Distance(u->child(), !negate, asgn);
+	return 1;
+}
+
+// Sum of the distances of all constraints, or false if one of them
+// cannot be evaluated.
+bool Cost(const vector<const SymbolicExpr*>& cs, const Assignment& asgn,
+		double* cost) {
+	*cost = 0;
+	for (size_t i = 0; i < cs.size(); i++) {
+		Value_t v;
+		if (!cs[i]->Evaluate(asgn, &v))
+			return false;
+		if (v.integral == 0)
+			*cost += Distance(cs[i], false, asgn);
+		if (*cost > DBL_MAX)
+			*cost = DBL_MAX;
+	}
+	return true;
+}
+
+void CollectConstants(const SymbolicExpr* e, set<double>* out) {
+	if (e->IsConcrete()) {
+		if (SymbolicExpr::IsFloatType(e->value().type))
+			out->insert(e->value().floating);
+		return;
+	}
+	if (const UnaryExpr* u = e->CastUnaryExpr()) {
+		CollectConstants(u->child(), out);
+	} else if (const BinExpr* b = e->CastBinExpr()) {
+		CollectConstants(b->get_left(), out);
+		CollectConstants(b->get_right(), out);
+	} else if (const PredExpr* p = e->CastPredExpr()) {
+		CollectConstants(p->left(), out);
+		CollectConstants(p->right(), out);
+	}
+}
+
+double RoundToType(double v, type_t ty) {
+	return (ty == types::FLOAT) ? (double)(float)v : v;
+}
+
+// The neighbour of v, as a value of type ty, one ulp up (or down).
+double NextUlp(double v, type_t ty, bool up) {
+	if (ty == types::FLOAT)
+		return nextafterf((float)v, up ? FLT_MAX : -FLT_MAX);
+	return nextafter(v, up ? DBL_MAX : -DBL_MAX);
+}
+
+}  // namespace
+
+
+bool FPLocalSearch::Solve(const map<var_t,type_t>& vars,
+		const vector<Value_t>& inputs,
+		const vector<const SymbolicExpr*>& constraints,
+		map<var_t,Value_t>* soln) {
+	if (constraints.empty())
+		return false;
+
+	// The floating-point variables of the branch being flipped.
+	set<var_t> target_vars;
+	constraints.back()->AppendVars(&target_vars);
+	map<var_t,type_t> fp_vars;
+	for (set<var_t>::const_iterator i = target_vars.begin(); i != target_vars.end(); ++i) {
+		map<var_t,type_t>::const_iterator it = vars.find(*i);
+		if (it != vars.end() && SymbolicExpr::IsFloatType(it->second)
+				&& *i < inputs.size())
+			fp_vars.insert(*it);
+	}
+	if (fp_vars.empty())
+		return false;
+
+	// Only constraints over those variables can change truth value.
+	vector<const SymbolicExpr*> cs;
+	set<double> consts;
+	for (size_t i = 0; i < constraints.size(); i++) {
+		if (constraints[i]->DependsOn(fp_vars)) {
+			cs.push_back(constraints[i]);
+			CollectConstants(constraints[i], &consts);
+		}
+	}
+
+	Assignment asgn;
+	set<var_t> all_vars;
+	for (size_t i = 0; i < cs.size(); i++)
+		cs[i]->AppendVars(&all_vars);
+	for (set<var_t>::const_iterator i = all_vars.begin(); i != all_vars.end(); ++i) {
+		if (*i >= inputs.size())
+			return false;
+		asgn[*i] = inputs[*i];
+	}
+
+	double cost;
+	if (!Cost(cs, asgn, &cost))
+		return false;
+
+	num_queries_++;
+
+	// Per-variable step sizes: grown on success, shrunk on failure.
+	map<var_t,double> step;
+	for (map<var_t,type_t>::const_iterator i = fp_vars.begin(); i != fp_vars.end(); ++i) {
+		double v = asgn[i->first].floating;
+		step[i->first] = (std::isfinite(v) && fabs(v) > 1) ? fabs(v) / 2 : 1;
+	}
+
+	size_t evals = 0;
+	while (cost > 0 && evals < kMaxEvaluations) {
+		bool improved = false;
+
+		for (map<var_t,type_t>::const_iterator i = fp_vars.begin();
+				i != fp_vars.end() && cost > 0; ++i) {
+			var_t x = i->first;
+			type_t ty = i->second;
+			double cur = asgn[x].floating;
+			double s = step[x];
+
+			vector<double> cands;
+			cands.push_back(cur + s);
+			cands.push_back(cur - s);
+			cands.push_back(NextUlp(cur, ty, true));
+			cands.push_back(NextUlp(cur, ty, false));
+			for (set<double>::const_iterator c = consts.begin(); c != consts.end(); ++c) {
+				cands.push_back(*c);
+				cands.push_back(NextUlp(*c, ty, true));
+				cands.push_back(NextUlp(*c, ty, false));
+			}
+
+			double best = cur, best_cost = cost;
+			for (size_t j = 0; j < cands.size() && evals < kMaxEvaluations; j++) {
+				double v = RoundToType(cands[j], ty);
+				if (!std::isfinite(v) || v == cur)
+					continue;
+				asgn[x].floating = v;
+				double c;
+				evals++;
+				if (Cost(cs, asgn, &c) && c < best_cost) {
+					best = v;
+					best_cost = c;
+				}
+			}
+
+			asgn[x].floating = best;
+			if (best_cost < cost) {
+				cost = best_cost;
+				step[x] = fabs(best - cur) * 2;
+				improved = true;
+			} else {
+				step[x] = s / 2;
+			}
+		}
+
+		if (!improved) {
+			// Stuck with every step collapsed to nothing.
+			bool all_tiny = true;
+			for (map<var_t,double>::const_iterator i = step.begin(); i != step.end(); ++i) {
+				if (i->second > DBL_MIN)
+					all_tiny = false;
+			}
+			if (all_tiny)
+				break;
+		}
+	}
+
+	if (cost > 0)
+		return false;
+
+	num_solved_++;
+	soln->clear();
+	for (map<var_t,type_t>::const_iterator i = fp_vars.begin(); i != fp_vars.end(); ++i) {
+		soln->insert(make_pair(i->first, asgn[i->first]));
+	}
+	return true;
+}
+
+}  // namespace crown
@@ -0,0 +1,52 @@
+// This file is part of CROWN, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef FP_LOCAL_SEARCH_H__
+#define FP_LOCAL_SEARCH_H__
+
+#include <map>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "run_crown/symbolic_expression.h"
+
+using std::map;
+using std::vector;
+
+namespace crown {
+
+/*
+ * Distance-guided local search over the floating-point inputs of a
+ * query, tried before Z3 when run_crown is given -FP_LOCAL_SEARCH.
+ *
+ * Only the float/double variables of the last (negated) constraint are
+ * mutated; constraints that do not depend on them keep the value they
+ * had on the current path.  The remaining constraints are evaluated
+ * natively (SymbolicExpr::Evaluate) and their summed distance to being
+ * satisfied is minimized.  If a query cannot be evaluated, or no
+ * solution is found within the budget, Solve() returns false and the
+ * caller falls back to Z3.
+ */
+class FPLocalSearch {
+public:
+	static bool Solve(const map<var_t,type_t>& vars,
+			const vector<Value_t>& inputs,
+			const vector<const SymbolicExpr*>& constraints,
+			map<var_t,Value_t>* soln);
+
+	// Queries tried, and queries solved, by the local search.
+	static size_t num_queries_;
+	static size_t num_solved_;
+
+private:
+	static const size_t kMaxEvaluations = 1000;
+};
+
+}  // namespace crown
+
+#endif  // FP_LOCAL_SEARCH_H__
@@ -10,6 +10,7 @@
 
 #include <cstring>
 #include <assert.h>
+#include <sstream>
 
 #include "base/basic_functions.h"
 #include "run_crown/object_tracker.h"
@@ -35,14 +36,29 @@ ObjectTracker::~ObjectTracker() {
 		for(size_t j = 0; j < objsSize; j++){
 			delete snapshotManager_[i]->at(j);
 		}
-		snapshotManager_[i]->clear();
+		delete snapshotManager_[i];
+		delete offsetManager_[i];
 	}
 }
 
 void ObjectTracker::Swap(ObjectTracker& tracker){
 	snapshotManager_.swap(tracker.snapshotManager_);
-	arraysManager_.swap(tracker.arraysManager_);
-	isCreateAST_.swap(tracker.isCreateAST_);
+	offsetManager_.swap(tracker.offsetManager_);
+	buffer_.swap(tracker.buffer_);
+	base_.swap(tracker.base_);
+	asts_.swap(tracker.asts_);
+	std::swap(epoch_, tracker.epoch_);
+}
+
+SymbolicObject* ObjectTracker::snapshot(size_t managerIdx, size_t snapshotIdx) const {
+	SymbolicObject*& obj = snapshotManager_[managerIdx]->at(snapshotIdx);
+	if (obj == NULL) {
+		const std::pair<size_t,size_t>& at = offsetManager_[managerIdx]->at(snapshotIdx);
+		std::istringstream in(buffer_.substr(at.first, at.second));
+		obj = SymbolicObject::Parse(in);
+		assert(obj != NULL);
+	}
+	return obj;
 }
 
 void ObjectTracker::AppendToString(string *s) const {
@@ -51,7 +67,7 @@ void ObjectTracker::AppendToString(string *s) const {
 		size_t objsSize = snapshotManager_[i]->size();	
 		for(size_t j = 0; j < objsSize; j++){
 			if(j==0) continue;
-			snapshotManager_[i]->at(j)->AppendToString(s);
+			snapshot(i, j)->AppendToString(s);
 		}
 	}
 }
@@ -66,19 +82,26 @@ bool ObjectTracker::Parse(istream& s){
 	assert(snapshotManager_.size()==0);
 	for(size_t i = 0; i < managerSize; i++){
 		snapshotManager_.push_back(new SnapshotVector());
-		arraysManager_.push_back(new ConcreteArrayVector());
-		astManager_.push_back(new ASTVector());
-		isCreateAST_.push_back(new BoolVector());
+		offsetManager_.push_back(new OffsetVector());
+		base_.push_back(asts_.size());
 
 		size_t objsSize;
 		s.read((char*)&objsSize, sizeof(size_t));
 #if DEBUG
 		printf("objSize: %d\n",objsSize);
 #endif
+		// Only index the snapshots; most are never dereferenced.
 		for(size_t j = 0; j < objsSize; j++){
-			SymbolicObject* obj = SymbolicObject::Parse(s);
-			snapshotManager_[i]->push_back(obj);
+			size_t len;
+			s.read((char*)&len, sizeof(len));
+			if (s.fail()) return false;
+			size_t offset = buffer_.size();
+			buffer_.resize(offset + len);
+			s.read(&buffer_[offset], len);
+			snapshotManager_[i]->push_back(NULL);
+			offsetManager_[i]->push_back(std::make_pair(offset, len));
 		}
+		asts_.resize(asts_.size() + objsSize);
 	}
 
 	return !s.fail();
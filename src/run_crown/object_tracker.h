@@ -14,6 +14,8 @@
 #include <cstdio>
 #include <ostream>
 #include <istream>
+#include <string>
+#include <utility>
 #include <vector>
 #include <z3.h>
 
@@ -29,13 +31,9 @@ class SymbolicObject;
 
 class ObjectTracker {
 typedef std::vector<SymbolicObject*> SnapshotVector;
-typedef std::vector<unsigned char*> ConcreteArrayVector;
-typedef std::vector<Z3_ast> ASTVector;
-typedef std::vector<bool> BoolVector;
+typedef std::vector<std::pair<size_t,size_t> > OffsetVector;
 public:
-	ObjectTracker() {
-		isASTInit = false;
-	}
+	ObjectTracker() : epoch_(1) { }
 	~ObjectTracker();
 	
 	bool Parse(istream& s);
@@ -46,16 +44,45 @@ public:
 	// For debugging.
 	void Dump() const;
 
-	std::vector<SnapshotVector*> snapshotManager(){ return snapshotManager_;}
-	std::vector<ASTVector*> astManager(){ return astManager_;}
-	std::vector<BoolVector*> isCreateAST(){ return isCreateAST_;}
-	bool isASTInit;
-	
+	size_t managerSize() const { return snapshotManager_.size(); }
+	size_t snapshotCount(size_t managerIdx) const {
+		return snapshotManager_[managerIdx]->size();
+	}
+	// Snapshots are decoded the first time they are asked for.
+	SymbolicObject* snapshot(size_t managerIdx, size_t snapshotIdx) const;
+
+	// Z3 arrays of the snapshots, cached for one solver call.
+	// ResetASTs drops them all by starting a new epoch.
+	bool FindAST(size_t managerIdx, size_t snapshotIdx, Z3_ast* ast) const {
+		const CachedAST& c = asts_[base_[managerIdx] + snapshotIdx];
+		if (c.epoch != epoch_)
+			return false;
+		*ast = c.ast;
+		return true;
+	}
+	void SetAST(size_t managerIdx, size_t snapshotIdx, Z3_ast ast) {
+		CachedAST& c = asts_[base_[managerIdx] + snapshotIdx];
+		c.ast = ast;
+		c.epoch = epoch_;
+	}
+	void ResetASTs() { epoch_++; }
+
 private:
+	// Entries are NULL until decoded from buffer_ at the (offset, length)
+	// of the same index in offsetManager_.
 	std::vector<SnapshotVector*> snapshotManager_;
-	std::vector<ConcreteArrayVector*> arraysManager_;
-	std::vector<ASTVector*> astManager_;
-	std::vector<BoolVector*> isCreateAST_;
+	std::vector<OffsetVector*> offsetManager_;
+	string buffer_;
+
+	// One entry per snapshot; base_ is the index of each manager's first.
+	struct CachedAST {
+		CachedAST() : ast(NULL), epoch(0) { }
+		Z3_ast ast;
+		size_t epoch;
+	};
+	std::vector<size_t> base_;
+	std::vector<CachedAST> asts_;
+	size_t epoch_;
 	//FIXME pairing needs
 };
 
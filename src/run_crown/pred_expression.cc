@@ -227,6 +227,58 @@ Z3_ast PredExpr::ConvertToSMTforFP(Z3_context ctx, Z3_solver sol,
 }
 
 
+bool PredExpr::Evaluate(const Assignment& a, Value_t* out) const {
+	Value_t l, r;
+	if (!left_->Evaluate(a, &l) || !right_->Evaluate(a, &r))
+		return false;
+	if (left_->value().type == types::LONG_DOUBLE
+			|| right_->value().type == types::LONG_DOUBLE)
+		return false;
+
+	bool lfp = IsFloatType(left_->value().type);
+	bool rfp = IsFloatType(right_->value().type);
+	bool res;
+
+	if (lfp && rfp) {
+		// Ordered comparisons are false (and != true) on NaN.
+		fp_value_t x = l.floating, y = r.floating;
+		switch (compare_op_) {
+			case ops::EQ:   res = (x == y); break;
+			case ops::NEQ:  res = (x != y); break;
+			case ops::GT: case ops::S_GT: res = (x > y); break;
+			case ops::LE: case ops::S_LE: res = (x <= y); break;
+			case ops::LT: case ops::S_LT: res = (x < y); break;
+			case ops::GE: case ops::S_GE: res = (x >= y); break;
+			default: return false;
+		}
+	} else if (lfp || rfp) {
+		return false;
+	} else if (ops::S_GT <= compare_op_ && compare_op_ <= ops::S_GE) {
+		value_t x = Truncate(l.integral, left_->size(), true);
+		value_t y = Truncate(r.integral, right_->size(), true);
+		switch (compare_op_) {
+			case ops::S_GT: res = (x > y); break;
+			case ops::S_LE: res = (x <= y); break;
+			case ops::S_LT: res = (x < y); break;
+			default:        res = (x >= y); break;
+		}
+	} else {
+		unsigned long long x = Truncate(l.integral, left_->size(), false);
+		unsigned long long y = Truncate(r.integral, right_->size(), false);
+		switch (compare_op_) {
+			case ops::EQ:  res = (x == y); break;
+			case ops::NEQ: res = (x != y); break;
+			case ops::GT:  res = (x > y); break;
+			case ops::LE:  res = (x <= y); break;
+			case ops::LT:  res = (x < y); break;
+			default:       res = (x >= y); break;
+		}
+	}
+
+	*out = Value_t(res, (fp_value_t)res, value().type);
+	return true;
+}
+
 bool PredExpr::Equals(const SymbolicExpr &e) const {
 	const PredExpr* c = e.CastPredExpr();
 	return ((c != NULL)
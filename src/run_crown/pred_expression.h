@@ -38,6 +38,7 @@ public:
 			 Z3_ast e1, Z3_ast e2) const;
 	 Z3_ast ConvertToSMTforFP(Z3_context ctx, Z3_solver sol,
 			 Z3_ast e1, Z3_ast e2) const;
+	 bool Evaluate(const Assignment& a, Value_t* out) const;
 
 	 const PredExpr* CastPredExpr() const { return this; }
 
@@ -49,6 +50,8 @@ public:
 	 const SymbolicExpr* right() const { return right_; }
 
 private:
+	 friend class SymbolicExprSimplifier;
+
 	 const ops::compare_op_t compare_op_;
 	 const SymbolicExpr *left_, *right_;
 };
@@ -15,14 +15,17 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include "run_crown/concolic_search.h"
+#include "run_crown/z3_solver.h"
 
 
 /* TCdir is a relative directory path to save generated test case files 
- * (i.e. input.1, input.2, ...)
+ * (i.e. inputs.pack and inputs.idx, see TestCaseIndex)
  * 2017.07.07 Hyunwoo Kim 
  */
 string TCdir;
 int flag_init_TC;
+int flag_fp_local_search;
+int flag_preserve_inputs;
 /* print_command_usage now shows -TCDIR option and more description about
  * search strategies 
  * 2017.07.07 Hyunwoo Kim 
@@ -30,7 +33,10 @@ int flag_init_TC;
 
 void print_command_usage() {
     std::cerr<<"Usage:"
-<<"\nrun_crown 'target args' <num-iter> -<Strategy> [-TCDIR <path>] [-INIT_TC]"
+<<"\nrun_crown 'target args' <num-iter> -<Strategy> [-TCDIR <path>] [-INIT_TC] [-FP_LOCAL_SEARCH]"
+<<"\n          [-SOLVER_TIMEOUT=<ms>] [-SOLVER_RLIMIT=<n>]"
+<<"\n          [-PORTFOLIO[=<num-configs>]] [-PRESERVE_INPUTS] [-SITE_BUDGET=<k>]"
+<<"\n          [-SYMBOLIC_FUNCS=<file>]"
 <<"\n-Note that <Strategy> can be one of {random, random_input, cfg, " 
 <<"\n cfg_baseline, hybrid, dfs, rev-dfs [<max-depth>], uniform_random [<max-depth>]}."
 <<std::endl;
@@ -65,19 +71,57 @@ int main(int argc, char* argv[]) {
     string prog = argv[1];
     int num_iters = atoi(argv[2]);
     string search_type = argv[3];
-	string last_param = argv[argc-1];
 
-	if(last_param == "-INIT_TC"){
-		struct stat buffer;
-		if(stat("input", &buffer) != 0){
-			std::cerr<<"Error: No initial test case given"<<std::endl;
-			exit(1);
+	// Trailing options, in any order.
+	flag_init_TC = 0;
+	flag_fp_local_search = 0;
+	flag_preserve_inputs = 0;
+	while(argc > 4){
+		string last_param = argv[argc-1];
+		if(last_param == "-INIT_TC"){
+			struct stat buffer;
+			if(stat("input", &buffer) != 0){
+				std::cerr<<"Error: No initial test case given"<<std::endl;
+				exit(1);
+			}
+			flag_init_TC = 1;
+		}else if(last_param == "-FP_LOCAL_SEARCH"){
+			flag_fp_local_search = 1;
+		}else if(last_param.compare(0, 16, "-SOLVER_TIMEOUT=") == 0
+				&& is_positive_int(last_param.substr(16))){
+			crown::Z3Solver::timeout_ms_ = atoi(last_param.c_str() + 16);
+		}else if(last_param == "-PRESERVE_INPUTS"){
+			flag_preserve_inputs = 1;
+		}else if(last_param == "-PORTFOLIO"){
+			crown::Z3Solver::portfolio_size_ = crown::Z3Solver::portfolio_wins_.size();
+		}else if(last_param.compare(0, 11, "-PORTFOLIO=") == 0
+				&& is_positive_int(last_param.substr(11))){
+			crown::Z3Solver::portfolio_size_ = atoi(last_param.c_str() + 11);
+		}else if(last_param.compare(0, 15, "-SOLVER_RLIMIT=") == 0
+				&& is_positive_int(last_param.substr(15))){
+			crown::Z3Solver::rlimit_ = atoi(last_param.c_str() + 15);
+		}else if(last_param.compare(0, 13, "-SITE_BUDGET=") == 0
+				&& is_positive_int(last_param.substr(13))){
+			// Keep only the first and last k constraints per branch site
+			// in each execution (read by libcrown).
+			setenv("CROWN_SITE_BUDGET", last_param.c_str() + 13, 1);
+		}else if(last_param.compare(0, 16, "-SYMBOLIC_FUNCS=") == 0
+				&& last_param.size() > 16){
+			// Only branches reached from the listed function ids yield
+			// constraints (read by libcrown).  The file may be func_ids
+			// itself or a subset of its lines.
+			struct stat buffer;
+			if(stat(last_param.c_str() + 16, &buffer) != 0){
+				std::cerr<<"Error: No such file: "<<last_param.c_str() + 16
+					<<std::endl;
+				exit(1);
+			}
+			setenv("CROWN_SYMBOLIC_FUNCS", last_param.c_str() + 16, 1);
+		}else{
+			break;
 		}
-		flag_init_TC = 1;
 		argc--;
 	}
-	else
-		flag_init_TC = 0;
 
     /* Updated to handle -TCDIR 
      * 2017.07.07 Hyunwoo Kim 
@@ -13,6 +13,7 @@
 #include <iomanip>
 #include <climits>
 #include <assert.h>
+#include <cstdio>
 
 #include "run_crown/symbolic_execution.h"
 
@@ -42,14 +43,22 @@ void SymbolicExecution::Swap(SymbolicExecution& se) {
     exprs_.swap(se.exprs_);
 	indexSize_.swap(se.indexSize_);
 	path_.Swap(se.path_);
-	ObjectTracker objTemp = object_tracker_;
-	object_tracker_ = se.object_tracker_;
-	se.object_tracker_ = objTemp;
-//	object_tracker_.Swap(se.object_tracker_);
+	object_tracker_.Swap(se.object_tracker_);
 }
 
-bool SymbolicExecution::Parse(istream& s) {
-	// Read the inputs.
+bool SymbolicExecution::ParseHeader(istream& s, ExecutionHeader* header) {
+	s.read((char*)header, sizeof(*header));
+	if (s.fail()) return false;
+	if ((header->magic != kExecutionMagic)
+			|| (header->version != kExecutionVersion)) {
+		fprintf(stderr, "Unsupported execution file (magic %x, version %u).\n",
+				header->magic, header->version);
+		return false;
+	}
+	return true;
+}
+
+bool SymbolicExecution::ParseInputs(istream& s) {
   char *tmp_str;
 	size_t len;
 
@@ -114,13 +123,52 @@ bool SymbolicExecution::Parse(istream& s) {
 	}
     free(tmp_str);
 
+	return !s.fail();
+}
+
+bool SymbolicExecution::ParseBranches(istream& s) {
+	ExecutionHeader header;
+	std::streampos start = s.tellg();
+	if (!ParseHeader(s, &header))
+		return false;
+
+	s.seekg(start + (std::streamoff)header.inputs_offset);
+	if (!ParseInputs(s))
+		return false;
+
+	s.seekg(start + (std::streamoff)header.branches_offset);
+	if (!path_.ParseBranches(s))
+		return false;
+	s.seekg(start + (std::streamoff)header.hits_offset);
+	return (path_.ParseHits(s) && !s.fail());
+}
+
+bool SymbolicExecution::Parse(istream& s) {
+	ExecutionHeader header;
+	std::streampos start = s.tellg();
+	if (!ParseHeader(s, &header))
+		return false;
+
+	// Read the inputs.
+	s.seekg(start + (std::streamoff)header.inputs_offset);
+	if (!ParseInputs(s))
+		return false;
+
 	//Read symbolicObjects
 	global_tracker_ = &object_tracker_;
+	s.seekg(start + (std::streamoff)header.tracker_offset);
 	object_tracker_.Parse(s);
 
     g_var_names = var_names_;
-	// Write the path.
-	return (path_.Parse(s) && !s.fail());
+	// Read the path.
+	s.seekg(start + (std::streamoff)header.branches_offset);
+	if (!path_.ParseBranches(s))
+		return false;
+	s.seekg(start + (std::streamoff)header.constraints_offset);
+	if (!path_.ParseConstraints(s))
+		return false;
+	s.seekg(start + (std::streamoff)header.hits_offset);
+	return (path_.ParseHits(s) && !s.fail());
 }
 
 }  // namespace crown
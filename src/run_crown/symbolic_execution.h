@@ -36,6 +36,9 @@ public:
 	void Swap(SymbolicExecution& se);
 
 	bool Parse(istream& s);
+	// Reads only the inputs and branches (no objects or constraints).
+	bool ParseBranches(istream& s);
+	static bool ParseHeader(istream& s, ExecutionHeader* header);
 
     const vector<string>& var_names() const { return var_names_; }
     const vector<Loc_t>& locations() const { return locations_; }
@@ -63,6 +66,8 @@ public:
 	ObjectTracker* object_tracker() {return &object_tracker_;}
 
 private:
+	bool ParseInputs(istream& s);
+
     vector<string> var_names_;
     vector<Loc_t> locations_;
 
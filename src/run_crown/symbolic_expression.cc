@@ -85,6 +85,48 @@ Z3_ast SymbolicExpr::ConvertToSMT(Z3_context ctx, Z3_solver sol) const {
 	}
 }
 
+bool SymbolicExpr::Evaluate(const Assignment& a, Value_t* out) const {
+	*out = value();
+	return true;
+}
+
+bool SymbolicExpr::IsSatisfiedBy(const vector<const SymbolicExpr*>& cs,
+		const Assignment& a) {
+	// The last constraint (the flipped branch, for a search query) is
+	// the most likely to fail.
+	for (size_t i = cs.size(); i-- > 0; ) {
+		Value_t v;
+		if (!cs[i]->Evaluate(a, &v) || v.integral == 0)
+			return false;
+	}
+	return true;
+}
+
+bool SymbolicExpr::IsSignedType(type_t ty) {
+	return (ty == types::CHAR || ty == types::SHORT || ty == types::INT
+			|| ty == types::LONG || ty == types::LONG_LONG);
+}
+
+value_t SymbolicExpr::Truncate(value_t v, size_t size, bool is_signed) {
+	if (size >= sizeof(value_t))
+		return v;
+	size_t shift = 8 * (sizeof(value_t) - size);
+	if (is_signed)
+		return (value_t)((unsigned long long)v << shift) >> shift;
+	return (value_t)(((unsigned long long)v << shift) >> shift);
+}
+
+Value_t SymbolicExpr::MakeValue(value_t v) const {
+	v = Truncate(v, size(), IsSignedType(value().type));
+	return Value_t(v, (fp_value_t)v, value().type);
+}
+
+Value_t SymbolicExpr::MakeFloatValue(fp_value_t f) const {
+	if (value().type == types::FLOAT)
+		f = (float)f;
+	return Value_t(0, f, value().type);
+}
+
 SymbolicExpr* SymbolicExpr::Parse(istream& s) {
 	Value_t val = Value_t();
 	size_t size;
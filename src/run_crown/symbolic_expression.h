@@ -15,6 +15,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 #include <z3.h>
 #include "base/basic_types.h"
 #include "run_crown/object_tracker.h"
@@ -23,6 +24,7 @@ using std::istream;
 using std::map;
 using std::set;
 using std::string;
+using std::vector;
 
 namespace crown {
 
@@ -37,6 +39,9 @@ class AtomicExpr;
 class DerefExpr;
 class SymbolicObject;
 
+// A (partial) assignment of values to the symbolic inputs.
+typedef map<var_t,Value_t> Assignment;
+
 class SymbolicExpr {
 public:
 	virtual ~SymbolicExpr();
@@ -53,6 +58,28 @@ public:
 	// Convert to Z3
 	virtual Z3_ast ConvertToSMT(Z3_context ctx, Z3_solver sol) const;
 
+	// Evaluates the expression under the assignment a, with the C
+	// semantics of the instrumented code.  Returns false if the value is
+	// not determined (unassigned variable, division by zero, memory not
+	// written on this path, ...).
+	virtual bool Evaluate(const Assignment& a, Value_t* out) const;
+
+	// True if every constraint in cs evaluates to true under a.
+	static bool IsSatisfiedBy(const vector<const SymbolicExpr*>& cs,
+			const Assignment& a);
+
+	// Classification of value types.  LONG_DOUBLE counts as floating
+	// point, although Evaluate leaves it undetermined.
+	static bool IsFloatType(type_t ty) {
+		return (ty == types::FLOAT || ty == types::DOUBLE
+				|| ty == types::LONG_DOUBLE);
+	}
+	static bool IsIntegralType(type_t ty) {
+		return ((types::U_CHAR <= ty && ty <= types::LONG_LONG)
+				|| ty == types::POINTER);
+	}
+	static bool IsSignedType(type_t ty);
+
 	// Parsing
 	static SymbolicExpr* Parse(istream& s);
 
@@ -78,6 +105,13 @@ protected:
 	SymbolicExpr(size_t size, Value_t value)
 		: unique_id_(++next),value_(value), size_(size) { }
 
+	// Helpers for Evaluate.
+	// The low size bytes of v, sign- or zero-extended.
+	static value_t Truncate(value_t v, size_t size, bool is_signed);
+	// v as a value of this node's size and type.
+	Value_t MakeValue(value_t v) const;
+	Value_t MakeFloatValue(fp_value_t f) const;
+
 
 	enum kNodeTags {
 		kBasicNodeTag = 0,
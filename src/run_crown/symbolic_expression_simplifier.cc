@@ -0,0 +1,235 @@
+// This file is part of CROWN, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <cstddef>
+
+#include "run_crown/symbolic_expression_simplifier.h"
+#include "run_crown/symbolic_expression_factory.h"
+
+namespace crown {
+
+namespace {
+
+// Expressions that ConvertToSMT turns into a Z3 boolean.
+bool IsBoolSorted(const SymbolicExpr* e) {
+	if (e->CastPredExpr())
+		return true;
+	const UnaryExpr* u = e->CastUnaryExpr();
+	return (u != NULL && u->unary_op() == ops::LOGICAL_NOT);
+}
+
+// A node can be replaced by its recorded concrete value if that value
+// converts back to the same Z3 sort.
+bool IsFoldable(const SymbolicExpr* e) {
+	type_t ty = e->value().type;
+	return (e->size() > 0 && e->size() <= sizeof(value_t)
+			&& (SymbolicExpr::IsIntegralType(ty) || ty == types::FLOAT
+				|| ty == types::DOUBLE));
+}
+
+bool IsCast(const UnaryExpr* u) {
+	return (u->unary_op() == ops::SIGNED_CAST
+			|| u->unary_op() == ops::UNSIGNED_CAST);
+}
+
+// An integer cast whose operand is an integer bit-vector.
+bool IsIntegralCast(const UnaryExpr* u) {
+	return (IsCast(u)
+			&& SymbolicExpr::IsIntegralType(u->value().type)
+			&& SymbolicExpr::IsIntegralType(u->child()->value().type)
+			&& !IsBoolSorted(u->child()));
+}
+
+bool IsCommutative(binary_op_t op) {
+	return (op == ops::ADD || op == ops::MULTIPLY
+			|| op == ops::BITWISE_AND || op == ops::BITWISE_OR
+			|| op == ops::BITWISE_XOR);
+}
+
+// (a op b) <=> (b SwapCompareOp(op) a)
+compare_op_t SwapCompareOp(compare_op_t op) {
+	switch (op) {
+		case ops::GT:   return ops::LT;
+		case ops::LT:   return ops::GT;
+		case ops::LE:   return ops::GE;
+		case ops::GE:   return ops::LE;
+		case ops::S_GT: return ops::S_LT;
+		case ops::S_LT: return ops::S_GT;
+		case ops::S_LE: return ops::S_GE;
+		case ops::S_GE: return ops::S_LE;
+		default:        return op;
+	}
+}
+
+}  // namespace
+
+
+SymbolicExpr* SymbolicExprSimplifier::Simplify(SymbolicExpr* e) {
+	if (e == NULL || e->IsConcrete())
+		return e;
+
+	if (e->CastUnaryExpr()) {
+		UnaryExpr* u = const_cast<UnaryExpr*>(e->CastUnaryExpr());
+		u->child_ = Simplify(const_cast<SymbolicExpr*>(u->child_));
+		return SimplifyUnary(u);
+	}
+	if (e->CastBinExpr()) {
+		BinExpr* b = const_cast<BinExpr*>(e->CastBinExpr());
+		b->left_ = Simplify(const_cast<SymbolicExpr*>(b->left_));
+		b->right_ = Simplify(const_cast<SymbolicExpr*>(b->right_));
+		return SimplifyBin(b);
+	}
+	if (e->CastPredExpr()) {
+		PredExpr* p = const_cast<PredExpr*>(e->CastPredExpr());
+		p->left_ = Simplify(const_cast<SymbolicExpr*>(p->left_));
+		p->right_ = Simplify(const_cast<SymbolicExpr*>(p->right_));
+		return SimplifyPred(p);
+	}
+	if (e->CastDerefExpr()) {
+		DerefExpr* d = const_cast<DerefExpr*>(e->CastDerefExpr());
+		d->addr_ = Simplify(const_cast<SymbolicExpr*>(d->addr_));
+		return d;
+	}
+	return e;
+}
+
+
+SymbolicExpr* SymbolicExprSimplifier::FoldToConstant(SymbolicExpr* e) {
+	SymbolicExpr* c = SymbolicExprFactory::NewConcreteExpr(e->size(), e->value());
+	delete e;
+	return c;
+}
+
+
+SymbolicExpr* SymbolicExprSimplifier::SimplifyUnary(UnaryExpr* e) {
+	const SymbolicExpr* child = e->child_;
+
+	if (child->IsConcrete()) {
+		// !c stays a Z3 boolean, so it is left alone.
+		if (e->unary_op() != ops::LOGICAL_NOT && IsFoldable(e))
+			return FoldToConstant(e);
+		return e;
+	}
+
+	const UnaryExpr* uc = child->CastUnaryExpr();
+	const PredExpr* pc = child->CastPredExpr();
+
+	if (e->unary_op() == ops::LOGICAL_NOT) {
+		// !!p ==> p, keeping the outer node's concrete value.
+		if (uc && uc->unary_op() == ops::LOGICAL_NOT
+				&& IsBoolSorted(uc->child())) {
+			SymbolicExpr* g = const_cast<SymbolicExpr*>(uc->child());
+			SymbolicExpr* res;
+			if (g->CastPredExpr()) {
+				PredExpr* gp = const_cast<PredExpr*>(g->CastPredExpr());
+				res = new PredExpr(gp->compare_op(),
+						const_cast<SymbolicExpr*>(gp->left_),
+						const_cast<SymbolicExpr*>(gp->right_),
+						e->size(), e->value());
+				gp->left_ = gp->right_ = NULL;
+			} else {
+				UnaryExpr* gu = const_cast<UnaryExpr*>(g->CastUnaryExpr());
+				res = new UnaryExpr(ops::LOGICAL_NOT,
+						const_cast<SymbolicExpr*>(gu->child_),
+						e->size(), e->value());
+				gu->child_ = NULL;
+			}
+			delete e;
+			return res;
+		}
+
+		// !(a op b) ==> (a !op b).  Not valid for floating point, where
+		// both sides are false if either operand is NaN.
+		if (pc && !SymbolicExpr::IsFloatType(pc->left()->value().type)
+				&& !SymbolicExpr::IsFloatType(pc->right()->value().type)) {
+			PredExpr* p = const_cast<PredExpr*>(pc);
+			PredExpr* res = new PredExpr(NegateCompareOp(p->compare_op()),
+					const_cast<SymbolicExpr*>(p->left_),
+					const_cast<SymbolicExpr*>(p->right_),
+					e->size(), e->value());
+			p->left_ = p->right_ = NULL;
+			delete e;
+			return res;
+		}
+		return e;
+	}
+
+	if (!IsIntegralCast(e))
+		return e;
+
+	// A cast to the same width and type is a no-op.  (Between signed and
+	// unsigned it is not: the type decides comparisons and extension.)
+	if ((e->size() == child->size())
+			&& (e->value().type == child->value().type)) {
+		e->child_ = NULL;
+		delete e;
+		return const_cast<SymbolicExpr*>(child);
+	}
+
+	// Collapse (T1)(T2)x.
+	if (uc && IsIntegralCast(uc)) {
+		size_t n = e->size(), m = uc->size(), k = uc->child()->size();
+		unary_op_t op;
+		if (n <= m && n <= k) {
+			// Only the low n bytes of x survive.
+			op = e->unary_op();
+		} else if (n <= m) {
+			// x is extended by the inner cast, then truncated to n.
+			op = uc->unary_op();
+		} else if (m >= k && e->unary_op() == uc->unary_op()) {
+			// Two extensions of the same kind.
+			op = e->unary_op();
+		} else {
+			return e;
+		}
+
+		UnaryExpr* inner = const_cast<UnaryExpr*>(uc);
+		UnaryExpr* res = new UnaryExpr(op,
+				const_cast<SymbolicExpr*>(inner->child_),
+				e->size(), e->value());
+		inner->child_ = NULL;
+		delete e;
+		return SimplifyUnary(res);
+	}
+
+	return e;
+}
+
+
+SymbolicExpr* SymbolicExprSimplifier::SimplifyBin(BinExpr* e) {
+	binary_op_t op = e->get_binary_op();
+
+	// CONCAT and EXTRACT record a rebuilt (not executed) value.
+	if (e->left_->IsConcrete() && e->right_->IsConcrete()
+			&& op != ops::CONCAT && op != ops::EXTRACT && IsFoldable(e)) {
+		return FoldToConstant(e);
+	}
+
+	if (IsCommutative(op) && e->left_->IsConcrete()
+			&& !e->right_->IsConcrete()) {
+		std::swap(e->left_, e->right_);
+	}
+	return e;
+}
+
+
+SymbolicExpr* SymbolicExprSimplifier::SimplifyPred(PredExpr* e) {
+	if (e->left_->IsConcrete() && !e->right_->IsConcrete()) {
+		PredExpr* res = new PredExpr(SwapCompareOp(e->compare_op()),
+				const_cast<SymbolicExpr*>(e->right_),
+				const_cast<SymbolicExpr*>(e->left_),
+				e->size(), e->value());
+		e->left_ = e->right_ = NULL;
+		delete e;
+		return res;
+	}
+	return e;
+}
+
+}  // namespace crown
@@ -0,0 +1,40 @@
+// This file is part of CROWN, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef SYMBOLIC_EXPRESSION_SIMPLIFIER_H__
+#define SYMBOLIC_EXPRESSION_SIMPLIFIER_H__
+
+#include "base/basic_types.h"
+#include "run_crown/symbolic_expression.h"
+
+namespace crown {
+
+/*
+ * Bottom-up rewriter for parsed path constraints, run once per path
+ * before any of its constraints are handed to the solver:
+ *  - folds operators whose operands are all concrete into a constant,
+ *  - cancels !!p and pushes ! into integer comparisons,
+ *  - drops same-width casts and collapses cast chains,
+ *  - moves constants to the right of comparisons and commutative ops.
+ */
+class SymbolicExprSimplifier {
+public:
+	// Takes ownership of e and returns the simplified expression.  Nodes
+	// that are rewritten away are deleted.
+	static SymbolicExpr* Simplify(SymbolicExpr* e);
+
+private:
+	static SymbolicExpr* SimplifyUnary(UnaryExpr* e);
+	static SymbolicExpr* SimplifyBin(BinExpr* e);
+	static SymbolicExpr* SimplifyPred(PredExpr* e);
+	static SymbolicExpr* FoldToConstant(SymbolicExpr* e);
+};
+
+}  // namespace crown
+
+#endif  // SYMBOLIC_EXPRESSION_SIMPLIFIER_H__
@@ -112,13 +112,10 @@ Z3_ast SymbolicObject::ConvertToSMT(Z3_context ctx, Z3_solver sol, Z3_ast array,
 #ifdef OPT2METHOD
 	if(snapshotIdx_ != 0){
 		ObjectTracker* tracker = global_tracker_;
-		if(tracker->isCreateAST()[managerIdx_]->at(snapshotIdx_-1) == false){
-			SymbolicObject* object = tracker->snapshotManager()[managerIdx_]->at(snapshotIdx_-1);
+		if(!tracker->FindAST(managerIdx_, snapshotIdx_-1, &array)){
+			SymbolicObject* object = tracker->snapshot(managerIdx_, snapshotIdx_-1);
 			array = object->ConvertToSMT(ctx, sol, array, output_type);
-			tracker->astManager()[managerIdx_]->at(snapshotIdx_-1) = array;
-			tracker->isCreateAST()[managerIdx_]->at(snapshotIdx_-1) = true;
-		}else{
-			array = tracker->astManager()[managerIdx_]->at(snapshotIdx_-1);
+			tracker->SetAST(managerIdx_, snapshotIdx_-1, array);
 		}
 	}
 #endif
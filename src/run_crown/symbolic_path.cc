@@ -9,6 +9,7 @@
 // for details.
 
 #include "run_crown/symbolic_path.h"
+#include "run_crown/symbolic_expression_simplifier.h"
 #include<assert.h>
 #include<iostream>
 
@@ -28,7 +29,8 @@ SymbolicPath::SymbolicPath(bool pre_allocate) {
 SymbolicPath::SymbolicPath(const SymbolicPath &p)
 		: branches_(p.branches_),
 		constraints_idx_(p.constraints_idx_),
-		constraints_(p.constraints_) {
+		constraints_(p.constraints_),
+		hits_(p.hits_) {
 	for(size_t i = 0; i < p.constraints_.size(); i++)
 		constraints_[i] = p.constraints_[i]->Clone();
 }
@@ -38,6 +40,7 @@ SymbolicPath & SymbolicPath::operator= (const SymbolicPath &p){
 	branches_ = p.branches_;
 	//branch_info_ = p.branch_info_;
 	constraints_idx_ = p.constraints_idx_;
+	hits_ = p.hits_;
 	for (size_t i = 0; i < constraints_.size(); i++){
 		delete constraints_[i];
 	}
@@ -58,14 +61,16 @@ void SymbolicPath::Swap(SymbolicPath& sp) {
 	branches_.swap(sp.branches_);
 	constraints_idx_.swap(sp.constraints_idx_);
 	constraints_.swap(sp.constraints_);
+	hits_.swap(sp.hits_);
 }
 
 bool SymbolicPath::Parse(istream& s) {
-	typedef vector<SymbolicExpr*>::iterator ConIt;
+	return ParseBranches(s) && ParseConstraints(s);
+}
+
+bool SymbolicPath::ParseBranches(istream& s) {
 	size_t len;
-    char *tmp_str;
 
-	SymbolicExpr::ReadTableClear();
 	// Read the path.
 	s.read((char*)&len, sizeof(size_t));
 	if (s.fail()) return false;
@@ -73,8 +78,15 @@ bool SymbolicPath::Parse(istream& s) {
 
 	branches_.resize(len);
 	s.read((char*)&branches_.front(), len * sizeof(branch_id_t));
-	if (s.fail())
-		return false;
+	return !s.fail();
+}
+
+bool SymbolicPath::ParseConstraints(istream& s) {
+	typedef vector<SymbolicExpr*>::iterator ConIt;
+	size_t len;
+    char *tmp_str;
+
+	SymbolicExpr::ReadTableClear();
 
 	// Clean up any existing path constraints.
 	for (size_t i = 0; i < constraints_.size(); i++){
@@ -114,4 +126,23 @@ bool SymbolicPath::Parse(istream& s) {
 	return !s.fail();
 }
 
+void SymbolicPath::Simplify() {
+	for (size_t i = 0; i < constraints_.size(); i++) {
+		constraints_[i] = SymbolicExprSimplifier::Simplify(constraints_[i]);
+	}
+}
+
+bool SymbolicPath::ParseHits(istream& s) {
+	size_t len;
+
+	// Read the bucketed hit counts.
+	s.read((char*)&len, sizeof(size_t));
+	if (s.fail()) return false;
+
+	hits_.resize(len);
+	if (len > 0)
+		s.read((char*)&hits_.front(), len);
+	return !s.fail();
+}
+
 }  // namespace crown
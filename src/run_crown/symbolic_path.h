@@ -38,10 +38,18 @@ public:
 	void Swap(SymbolicPath& sp);
 
 	bool Parse(istream& s);
+	bool ParseBranches(istream& s);
+	bool ParseConstraints(istream& s);
+	bool ParseHits(istream& s);
+
+	// Rewrites the parsed constraints with SymbolicExprSimplifier.
+	void Simplify();
 
 	const vector<branch_id_t>& branches() const { return branches_; }
 	const vector<SymbolicExpr*>& constraints() const { return constraints_; }
 	const vector<size_t>& constraints_idx() const { return constraints_idx_; }
+	// Bucketed hit count of each branch id (see SymbolicPathWriter).
+	const vector<unsigned char>& hits() const { return hits_; }
 
     const vector<Loc_t>& locations() const { return locations_; }
     vector<Loc_t>* mutable_locations() { return &locations_; }
@@ -52,6 +60,7 @@ private:
 	vector<branch_id_t> branches_;
 	vector<size_t> constraints_idx_;
 	vector<SymbolicExpr*> constraints_;
+	vector<unsigned char> hits_;
 };
 
 }  // namespace crown
@@ -0,0 +1,265 @@
+// This file is part of CROWN, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <utility>
+
+#include "run_crown/syntactic_check.h"
+#include "run_crown/atomic_expression.h"
+#include "run_crown/unary_expression.h"
+#include "run_crown/bin_expression.h"
+#include "run_crown/pred_expression.h"
+
+using std::make_pair;
+using std::max;
+using std::min;
+
+namespace crown {
+
+namespace {
+
+bool IsSignedCompare(compare_op_t op) {
+	return (ops::S_GT <= op && op <= ops::S_GE);
+}
+
+// The unsigned counterpart of a signed comparison.
+compare_op_t BaseCompareOp(compare_op_t op) {
+	switch (op) {
+		case ops::S_GT: return ops::GT;
+		case ops::S_LE: return ops::LE;
+		case ops::S_LT: return ops::LT;
+		case ops::S_GE: return ops::GE;
+		default:        return op;
+	}
+}
+
+// Reads a root constraint as (neg ? !p : p).
+bool AsLiteral(const SymbolicExpr* e, const PredExpr** p, bool* neg) {
+	*neg = false;
+	for (;;) {
+		if ((*p = e->CastPredExpr()) != NULL)
+			return true;
+		const UnaryExpr* u = e->CastUnaryExpr();
+		if (u == NULL || u->unary_op() != ops::LOGICAL_NOT)
+			return false;
+		*neg = !*neg;
+		e = u->child();
+	}
+}
+
+// Whether literal (n1 ? !p1 : p1) is the negation of (n2 ? !p2 : p2).
+bool Complementary(const PredExpr* p1, bool n1, const PredExpr* p2, bool n2) {
+	if (!SyntacticCheck::SameExpr(p1->left(), p2->left())
+			|| !SyntacticCheck::SameExpr(p1->right(), p2->right()))
+		return false;
+	if (p1->compare_op() == p2->compare_op())
+		return (n1 != n2);
+	// With NaN both (a op b) and (a !op b) can be false.
+	if (SymbolicExpr::IsFloatType(p1->left()->value().type))
+		return false;
+	return (n1 == n2 && p1->compare_op() == NegateCompareOp(p2->compare_op()));
+}
+
+// A literal of the form (x op c) over an integer input x.
+struct Bound {
+	var_t var;
+	size_t size;
+	compare_op_t op;
+	unsigned long long c;
+};
+
+bool AsBound(const PredExpr* p, bool neg, Bound* b) {
+	const AtomicExpr* x = p->left()->CastAtomicExpr();
+	const SymbolicExpr* c = p->right();
+	if (x == NULL || !c->IsConcrete()
+			|| !SymbolicExpr::IsIntegralType(x->value().type)
+			|| !SymbolicExpr::IsIntegralType(c->value().type)
+			|| x->size() != c->size()
+			|| x->size() == 0 || x->size() > sizeof(value_t))
+		return false;
+
+	b->var = x->variable();
+	b->size = x->size();
+	b->op = neg ? NegateCompareOp(p->compare_op()) : p->compare_op();
+	b->c = (unsigned long long)c->value().integral;
+	if (b->size < sizeof(value_t))
+		b->c &= (1ULL << (8 * b->size)) - 1;
+	return true;
+}
+
+// Closed interval of values allowed by a set of bounds.
+template <typename T>
+struct Range {
+	T lo, hi;
+	bool empty;
+
+	Range(T l, T h) : lo(l), hi(h), empty(false) { }
+
+	void Apply(compare_op_t op, T c) {
+		if (empty)
+			return;
+		switch (op) {
+			case ops::EQ:
+				lo = max(lo, c);
+				hi = min(hi, c);
+				break;
+			case ops::NEQ:
+				if (lo == c && hi == c)
+					empty = true;
+				else if (lo == c)
+					lo++;
+				else if (hi == c)
+					hi--;
+				break;
+			case ops::LT:
+				if (c <= lo)
+					empty = true;
+				else
+					hi = min(hi, (T)(c - 1));
+				break;
+			case ops::LE:
+				hi = min(hi, c);
+				break;
+			case ops::GT:
+				if (c >= hi)
+					empty = true;
+				else
+					lo = max(lo, (T)(c + 1));
+				break;
+			case ops::GE:
+				lo = max(lo, c);
+				break;
+			default:
+				break;
+		}
+		if (lo > hi)
+			empty = true;
+	}
+};
+
+long long SignExtend(unsigned long long v, size_t size) {
+	if (size >= sizeof(value_t))
+		return (long long)v;
+	size_t shift = 8 * (sizeof(value_t) - size);
+	return (long long)(v << shift) >> shift;
+}
+
+}  // namespace
+
+
+bool SyntacticCheck::SameExpr(const SymbolicExpr* a, const SymbolicExpr* b) {
+	if (a->size() != b->size() || a->value().type != b->value().type)
+		return false;
+	if (a->IsConcrete() || b->IsConcrete()) {
+		if (!a->IsConcrete() || !b->IsConcrete())
+			return false;
+		if (SymbolicExpr::IsFloatType(a->value().type)) {
+			fp_value_t x = a->value().floating, y = b->value().floating;
+			return (x == y && std::signbit(x) == std::signbit(y));
+		}
+		return (a->value().integral == b->value().integral);
+	}
+
+	if (const AtomicExpr* x = a->CastAtomicExpr()) {
+		const AtomicExpr* y = b->CastAtomicExpr();
+		return (y != NULL && x->variable() == y->variable());
+	}
+	if (const UnaryExpr* x = a->CastUnaryExpr()) {
+		const UnaryExpr* y = b->CastUnaryExpr();
+		return (y != NULL && x->unary_op() == y->unary_op()
+				&& SameExpr(x->child(), y->child()));
+	}
+	if (const BinExpr* x = a->CastBinExpr()) {
+		const BinExpr* y = b->CastBinExpr();
+		return (y != NULL && x->get_binary_op() == y->get_binary_op()
+				&& SameExpr(x->get_left(), y->get_left())
+				&& SameExpr(x->get_right(), y->get_right()));
+	}
+	if (const PredExpr* x = a->CastPredExpr()) {
+		const PredExpr* y = b->CastPredExpr();
+		return (y != NULL && x->compare_op() == y->compare_op()
+				&& SameExpr(x->left(), y->left())
+				&& SameExpr(x->right(), y->right()));
+	}
+	return false;
+}
+
+
+SyntacticCheck::Result SyntacticCheck::Check(const map<var_t,type_t>& vars,
+		const vector<Value_t>& inputs,
+		const vector<const SymbolicExpr*>& cs,
+		map<var_t,Value_t>* soln) {
+	if (cs.empty())
+		return UNKNOWN;
+
+	const PredExpr* target;
+	bool target_neg;
+	if (!AsLiteral(cs.back(), &target, &target_neg))
+		return UNKNOWN;
+
+	// The negated branch contradicts an earlier constraint.
+	for (size_t i = 0; i + 1 < cs.size(); i++) {
+		const PredExpr* p;
+		bool neg;
+		if (AsLiteral(cs[i], &p, &neg) && Complementary(p, neg, target, target_neg))
+			return UNSAT;
+	}
+
+	Bound tb;
+	if (!AsBound(target, target_neg, &tb))
+		return UNKNOWN;
+	map<var_t,type_t>::const_iterator var = vars.find(tb.var);
+	if (var == vars.end() || kSizeOfType[var->second] != tb.size
+			|| tb.var >= inputs.size())
+		return UNKNOWN;
+
+	// Intersect every bound on the branch's variable.
+	size_t bits = 8 * tb.size;
+	unsigned long long umax = (bits < 64) ? (1ULL << bits) - 1 : ULLONG_MAX;
+	long long smax = (long long)(umax >> 1);
+	Range<unsigned long long> ur(0, umax);
+	Range<long long> sr(-smax - 1, smax);
+	for (size_t i = 0; i < cs.size(); i++) {
+		const PredExpr* p;
+		bool neg;
+		Bound b;
+		if (!AsLiteral(cs[i], &p, &neg) || !AsBound(p, neg, &b)
+				|| b.var != tb.var || b.size != tb.size)
+			continue;
+		if (!IsSignedCompare(b.op))
+			ur.Apply(b.op, b.c);
+		if (IsSignedCompare(b.op) || b.op == ops::EQ || b.op == ops::NEQ)
+			sr.Apply(BaseCompareOp(b.op), SignExtend(b.c, b.size));
+	}
+	if (ur.empty || sr.empty)
+		return UNSAT;
+
+	// Try the ends of both ranges against the whole query.
+	unsigned long long cands[] = { ur.lo, ur.hi,
+		(unsigned long long)sr.lo, (unsigned long long)sr.hi };
+	Assignment a;
+	for (size_t i = 0; i < inputs.size(); i++)
+		a[i] = inputs[i];
+	type_t ty = var->second;
+	for (size_t i = 0; i < sizeof(cands) / sizeof(cands[0]); i++) {
+		unsigned long long v = cands[i] & umax;
+		value_t iv = SymbolicExpr::IsSignedType(ty)
+			? SignExtend(v, tb.size) : (value_t)v;
+		a[tb.var] = Value_t(iv, (fp_value_t)iv, ty);
+		if (SymbolicExpr::IsSatisfiedBy(cs, a)) {
+			soln->clear();
+			soln->insert(make_pair(tb.var, a[tb.var]));
+			return SAT;
+		}
+	}
+	return UNKNOWN;
+}
+
+}  // namespace crown
@@ -0,0 +1,51 @@
+// This file is part of CROWN, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef SYNTACTIC_CHECK_H__
+#define SYNTACTIC_CHECK_H__
+
+#include <map>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "run_crown/symbolic_expression.h"
+
+using std::map;
+using std::vector;
+
+namespace crown {
+
+/*
+ * Cheap pre-check of a query (a path prefix with the negated branch
+ * last), done before any solver context is built.
+ *
+ * UNSAT: an earlier constraint is the structural complement of the
+ * negated branch, or the integer bounds (x op c) on the branch's
+ * variable leave no value for it.
+ *
+ * SAT: the branch is a bound on a single integer input, and one of the
+ * ends of that input's feasible range satisfies every constraint when
+ * evaluated natively.  The new value is returned in soln.
+ */
+class SyntacticCheck {
+public:
+	enum Result { UNKNOWN, UNSAT, SAT };
+
+	static Result Check(const map<var_t,type_t>& vars,
+			const vector<Value_t>& inputs,
+			const vector<const SymbolicExpr*>& constraints,
+			map<var_t,Value_t>* soln);
+
+	// Structural equality, stricter than SymbolicExpr::Equals: widths
+	// and types must match, and dereferences never compare equal.
+	static bool SameExpr(const SymbolicExpr* a, const SymbolicExpr* b);
+};
+
+}  // namespace crown
+
+#endif  // SYNTACTIC_CHECK_H__
@@ -9,6 +9,7 @@
 #include <assert.h>
 #include <cstdio>
 #include <cstdlib>
+#include <cmath>
 #include <iostream>
 #include "run_crown/unary_expression.h"
 
@@ -262,6 +263,62 @@ Z3_ast UnaryExpr::ConvertToSMT(Z3_context ctx, Z3_solver sol) const {
 
 }
 
+bool UnaryExpr::Evaluate(const Assignment& a, Value_t* out) const {
+	Value_t c;
+	if (!child_->Evaluate(a, &c))
+		return false;
+
+	type_t ty = value().type;
+	bool child_fp = IsFloatType(child_->value().type);
+	if (ty == types::LONG_DOUBLE || child_->value().type == types::LONG_DOUBLE)
+		return false;
+
+	switch (unary_op_) {
+		case ops::NEGATE:
+			*out = IsFloatType(ty) ? MakeFloatValue(-c.floating)
+				: MakeValue((value_t)(0ULL - (unsigned long long)c.integral));
+			return true;
+
+		case ops::LOGICAL_NOT: {
+			value_t b = child_fp ? (c.floating == 0) : (c.integral == 0);
+			*out = Value_t(b, (fp_value_t)b, ty);
+			return true;
+		}
+
+		case ops::BITWISE_NOT:
+			*out = MakeValue(~c.integral);
+			return true;
+
+		case ops::SIGNED_CAST:
+		case ops::UNSIGNED_CAST: {
+			bool is_signed = (unary_op_ == ops::SIGNED_CAST);
+			if (IsFloatType(ty)) {
+				if (child_fp) {
+					*out = MakeFloatValue(c.floating);
+				} else {
+					value_t v = Truncate(c.integral, child_->size(), is_signed);
+					*out = MakeFloatValue(is_signed ? (fp_value_t)v
+							: (fp_value_t)(unsigned long long)v);
+				}
+			} else if (child_fp) {
+				// Truncation toward zero; out-of-range values are undefined.
+				fp_value_t t = trunc(c.floating);
+				fp_value_t range = ldexp(1.0, 8 * size() - (IsSignedType(ty) ? 1 : 0));
+				if (!(t < range && t >= (IsSignedType(ty) ? -range : 0)))
+					return false;
+				*out = IsSignedType(ty) ? MakeValue((value_t)t)
+					: MakeValue((value_t)(unsigned long long)t);
+			} else {
+				*out = MakeValue(Truncate(c.integral, child_->size(), is_signed));
+			}
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
 bool UnaryExpr::Equals(const SymbolicExpr &e) const {
 	const UnaryExpr* u = e.CastUnaryExpr();
 	return ((u != NULL)
@@ -34,6 +34,7 @@ class UnaryExpr : public SymbolicExpr {
   bool IsConcrete() const { return false; }
 
   Z3_ast ConvertToSMT(Z3_context ctx, Z3_solver sol) const;
+  bool Evaluate(const Assignment& a, Value_t* out) const;
 
   const UnaryExpr* CastUnaryExpr() const { return this; }
 
@@ -44,6 +45,8 @@ class UnaryExpr : public SymbolicExpr {
   const SymbolicExpr* child() const { return child_; }
 
  private:
+  friend class SymbolicExprSimplifier;
+
   const SymbolicExpr *child_;
   const ops::unary_op_t unary_op_;
 };
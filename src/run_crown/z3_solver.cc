@@ -7,6 +7,8 @@
 // for details.
 
 #include <assert.h>
+#include <pthread.h>
+#include <algorithm>
 #include <queue>
 #include <set>
 #include <iostream>
@@ -48,8 +50,393 @@ namespace crown {
 
 typedef vector<const SymbolicExpr*>::const_iterator PredIt;
 
+namespace {
+
+// Solver configurations raced by the portfolio mode.  A NULL tactic list
+// is Z3's default solver; otherwise the tactics are run in sequence.
+struct PortfolioConfig {
+	const char* name;
+	const char* tactics[6];
+};
+
+const PortfolioConfig kPortfolio[] = {
+	{ "default",      { NULL } },
+	{ "qfbv",         { "qfbv", NULL } },
+	{ "bitblast-sat", { "simplify", "solve-eqs", "bit-blast", "sat", NULL } },
+	{ "qfaufbv",      { "qfaufbv", NULL } },
+	{ "qffpbv",       { "qffpbv", NULL } },
+};
+const size_t kNumPortfolio = sizeof(kPortfolio) / sizeof(kPortfolio[0]);
+
+struct PortfolioRace {
+	pthread_mutex_t mu;
+	pthread_cond_t done;
+	size_t finished;
+	int winner;
+};
+
+struct PortfolioWorker {
+	int index;
+	size_t config;
+	Z3_context ctx;
+	Z3_solver sol;
+	Z3_lbool result;
+	pthread_t thread;
+	PortfolioRace* race;
+};
+
+// Interrupted or unsupported checks are reported as errors; the check
+// then returns UNKNOWN, which is all the race needs to know.
+void IgnoreZ3Error(Z3_context ctx, Z3_error_code e) {
+	IFDEBUG(std::cerr << "portfolio: " << Z3_get_error_msg(ctx, e) << std::endl);
+}
+
+void* RunPortfolioWorker(void* arg) {
+	PortfolioWorker* w = static_cast<PortfolioWorker*>(arg);
+	w->result = Z3_solver_check(w->ctx, w->sol);
+	PortfolioRace* race = w->race;
+	pthread_mutex_lock(&race->mu);
+	race->finished++;
+	if (race->winner < 0 && w->result != Z3_L_UNDEF)
+		race->winner = w->index;
+	pthread_cond_signal(&race->done);
+	pthread_mutex_unlock(&race->mu);
+	return NULL;
+}
+
+// Returns a solver with one reference held by the caller.  Solvers and
+// tactics are reference counted even in a non-rc context.
+Z3_solver MakePortfolioSolver(Z3_context ctx, const PortfolioConfig& conf) {
+	if (conf.tactics[0] == NULL) {
+		Z3_solver s = Z3_mk_solver(ctx);
+		Z3_solver_inc_ref(ctx, s);
+		return s;
+	}
+	Z3_tactic t = Z3_mk_tactic(ctx, conf.tactics[0]);
+	Z3_tactic_inc_ref(ctx, t);
+	for (size_t i = 1; conf.tactics[i] != NULL; i++) {
+		Z3_tactic next = Z3_mk_tactic(ctx, conf.tactics[i]);
+		Z3_tactic_inc_ref(ctx, next);
+		Z3_tactic both = Z3_tactic_and_then(ctx, t, next);
+		Z3_tactic_inc_ref(ctx, both);
+		Z3_tactic_dec_ref(ctx, t);
+		Z3_tactic_dec_ref(ctx, next);
+		t = both;
+	}
+	Z3_solver s = Z3_mk_solver_from_tactic(ctx, t);
+	Z3_solver_inc_ref(ctx, s);
+	Z3_tactic_dec_ref(ctx, t);
+	return s;
+}
+
+}  // namespace
+
+size_t Z3Solver::portfolio_size_ = 0;
+vector<size_t> Z3Solver::portfolio_wins_(kNumPortfolio, 0);
+vector<size_t> Z3Solver::portfolio_attempts_(kNumPortfolio, 0);
+
+
+void Z3Solver::SetLimits(Z3_context ctx, Z3_solver sol, unsigned limit_scale) {
+	if (!timeout_ms_ && !rlimit_)
+		return;
+	Z3_params params = Z3_mk_params(ctx);
+	Z3_params_inc_ref(ctx, params);
+	if (timeout_ms_)
+		Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "timeout"),
+				timeout_ms_ * limit_scale);
+	if (rlimit_)
+		Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "rlimit"),
+				rlimit_ * limit_scale);
+	Z3_solver_set_params(ctx, sol, params);
+	Z3_params_dec_ref(ctx, params);
+}
+
+
+// Races the portfolio configurations with the best win rate so far, each in
+// its own context on its own thread, on the assertions of sol.  Z3
+// contexts are not thread safe, so everything is translated up front and
+// the losers are interrupted once one answers SAT or UNSAT.
+//
+// On return *wctx/*wsol hold the winner (ctx/sol if nobody answered);
+// the caller reads the model from them and then calls
+// FreePortfolioContexts.
+Z3_lbool Z3Solver::PortfolioCheck(Z3_context ctx, Z3_solver sol,
+		unsigned limit_scale, vector<Z3_context>* ctxs,
+		Z3_context* wctx, Z3_solver* wsol) {
+	vector<size_t> order(kNumPortfolio);
+	for (size_t i = 0; i < kNumPortfolio; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), BetterWinRate);
+	size_t n = std::min(portfolio_size_, kNumPortfolio);
+
+	Z3_ast_vector as = Z3_solver_get_assertions(ctx, sol);
+	Z3_ast_vector_inc_ref(ctx, as);
+
+	PortfolioRace race;
+	pthread_mutex_init(&race.mu, NULL);
+	pthread_cond_init(&race.done, NULL);
+	race.finished = 0;
+	race.winner = -1;
+
+	vector<PortfolioWorker> workers(n);
+	for (size_t i = 0; i < n; i++) {
+		PortfolioWorker& w = workers[i];
+		Z3_config cfg = Z3_mk_config();
+		Z3_set_param_value(cfg, "MODEL", "true");
+		w.index = static_cast<int>(i);
+		w.config = order[i];
+		w.ctx = Z3_mk_context(cfg);
+		Z3_del_config(cfg);
+		Z3_set_error_handler(w.ctx, IgnoreZ3Error);
+		w.sol = MakePortfolioSolver(w.ctx, kPortfolio[w.config]);
+		SetLimits(w.ctx, w.sol, limit_scale);
+		for (unsigned j = 0; j < Z3_ast_vector_size(ctx, as); j++) {
+			Z3_solver_assert(w.ctx, w.sol,
+					Z3_translate(ctx, Z3_ast_vector_get(ctx, as, j), w.ctx));
+		}
+		w.result = Z3_L_UNDEF;
+		w.race = &race;
+		ctxs->push_back(w.ctx);
+		portfolio_attempts_[w.config]++;
+	}
+	Z3_ast_vector_dec_ref(ctx, as);
+
+	for (size_t i = 0; i < n; i++)
+		pthread_create(&workers[i].thread, NULL, RunPortfolioWorker, &workers[i]);
+
+	pthread_mutex_lock(&race.mu);
+	while (race.winner < 0 && race.finished < n)
+		pthread_cond_wait(&race.done, &race.mu);
+	int winner = race.winner;
+	pthread_mutex_unlock(&race.mu);
+
+	// An interrupted context cannot hand out a model, so the winner is
+	// left alone.
+	for (size_t i = 0; i < n; i++) {
+		if (static_cast<int>(i) != winner)
+			Z3_interrupt(workers[i].ctx);
+	}
+	for (size_t i = 0; i < n; i++)
+		pthread_join(workers[i].thread, NULL);
+	pthread_mutex_destroy(&race.mu);
+	pthread_cond_destroy(&race.done);
+
+	*wctx = ctx;
+	*wsol = sol;
+	if (winner < 0)
+		return Z3_L_UNDEF;
+	PortfolioWorker& w = workers[winner];
+	portfolio_wins_[w.config]++;
+	*wctx = w.ctx;
+	*wsol = w.sol;
+	return w.result;
+}
+
+
+// Whether an input whose type satisfies pred occurs in constraints.
+static bool HasVars(const map<var_t,type_t>& vars,
+		const vector<const SymbolicExpr*>& constraints, bool (*pred)(type_t)) {
+	set<var_t> used;
+	for (size_t i = 0; i < constraints.size(); i++)
+		constraints[i]->AppendVars(&used);
+	for (set<var_t>::const_iterator i = used.begin(); i != used.end(); ++i) {
+		map<var_t,type_t>::const_iterator v = vars.find(*i);
+		if (v != vars.end() && pred(v->second))
+			return true;
+	}
+	return false;
+}
+
+static bool IsFloatVar(type_t ty) {
+	return (ty == types::FLOAT) || (ty == types::DOUBLE);
+}
+
+static bool IsBitfieldVar(type_t ty) {
+	return (ty >= types::BITFIELD_CHAR);
+}
+
+bool Z3Solver::HasFloatVars(const map<var_t,type_t>& vars,
+		const vector<const SymbolicExpr*>& constraints) {
+	return HasVars(vars, constraints, IsFloatVar);
+}
+
+bool Z3Solver::HasBitfieldVars(const map<var_t,type_t>& vars,
+		const vector<const SymbolicExpr*>& constraints) {
+	return HasVars(vars, constraints, IsBitfieldVar);
+}
+
+
+// Maps the unsat core of sol back to indices into lits.  ASTs are
+// compared by id: Z3_is_eq_ast returns a bool in newer versions of Z3,
+// which include/z3_api.h declares as an int.
+void Z3Solver::ReadUnsatCore(Z3_context ctx, Z3_solver sol,
+		const vector<Z3_ast>& lits, vector<size_t>* core) {
+	core->clear();
+	Z3_ast_vector v = Z3_solver_get_unsat_core(ctx, sol);
+	Z3_ast_vector_inc_ref(ctx, v);
+	unsigned n = Z3_ast_vector_size(ctx, v);
+	for (size_t i = 0; i < lits.size(); i++) {
+		for (unsigned j = 0; j < n; j++) {
+			if (Z3_get_ast_id(ctx, lits[i])
+					== Z3_get_ast_id(ctx, Z3_ast_vector_get(ctx, v, j))) {
+				core->push_back(i);
+				break;
+			}
+		}
+	}
+	Z3_ast_vector_dec_ref(ctx, v);
+}
+
+
+// Finds which of the asserted constraints cs make sol UNSAT.  Checking
+// with assumptions puts Z3 in its incremental mode, which can be much
+// slower, so this is a second check that only UNSAT queries pay for,
+// limited to about as long as the first one took: each c in cs is
+// guarded by a literal (l => c) in a fresh solver and the literals are
+// assumed.
+void Z3Solver::ComputeUnsatCore(Z3_context ctx, Z3_solver sol,
+		const vector<Z3_ast>& cs, long check_ms, vector<size_t>* core) {
+	core->clear();
+	Z3_solver csol = Z3_mk_solver(ctx);
+	Z3_solver_inc_ref(ctx, csol);
+	Z3_params params = Z3_mk_params(ctx);
+	Z3_params_inc_ref(ctx, params);
+	Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "timeout"),
+			std::max((unsigned)kMinCoreTimeout, (unsigned)check_ms));
+	Z3_solver_set_params(ctx, csol, params);
+	Z3_params_dec_ref(ctx, params);
+
+	// Side conditions asserted while converting are kept as they are.
+	set<Z3_ast> guarded(cs.begin(), cs.end());
+	Z3_ast_vector as = Z3_solver_get_assertions(ctx, sol);
+	Z3_ast_vector_inc_ref(ctx, as);
+	for (unsigned j = 0; j < Z3_ast_vector_size(ctx, as); j++) {
+		Z3_ast a = Z3_ast_vector_get(ctx, as, j);
+		if (guarded.find(a) == guarded.end())
+			Z3_solver_assert(ctx, csol, a);
+	}
+	Z3_ast_vector_dec_ref(ctx, as);
+
+	vector<Z3_ast> lits;
+	for (size_t i = 0; i < cs.size(); i++) {
+		char name[32];
+		sprintf(name, "crown_c%zu", i);
+		lits.push_back(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, name),
+					Z3_mk_bool_sort(ctx)));
+		Z3_solver_assert(ctx, csol, Z3_mk_implies(ctx, lits[i], cs[i]));
+	}
+
+	if (!lits.empty()
+			&& Z3_solver_check_assumptions(ctx, csol, lits.size(), &lits[0]) == Z3_L_FALSE)
+		ReadUnsatCore(ctx, csol, lits, core);
+	Z3_solver_dec_ref(ctx, csol);
+}
+
+
+// Re-checks a satisfiable query, in a fresh solver with the assertions
+// of sol, assuming that every input keeps its preferred (previous)
+// value.  One preference from each unsat core is dropped until the
+// query is satisfiable again, giving up after kMaxPreferRounds rounds.
+// Like ComputeUnsatCore, this is limited to about as long as the first
+// check took.  Replaces the values in soln and returns true if a model
+// was found.
+bool Z3Solver::PreferValues(Z3_context ctx, Z3_solver sol,
+		const map<var_t,type_t>& vars, const vector<Value_t>& preferred,
+		long check_ms, map<var_t,Value_t>* soln) {
+	vector<Z3_ast> prefs;
+	for (map<var_t,type_t>::const_iterator i = vars.begin(); i != vars.end(); ++i) {
+		if (i->first >= preferred.size())
+			continue;
+		const Value_t& v = preferred[i->first];
+		Z3_ast x = x_decl[i->first];
+		Z3_sort s = Z3_get_sort(ctx, x);
+		Z3_ast c;
+		if (i->second == types::FLOAT) {
+			c = Z3_mk_fpa_numeral_float(ctx, v.floating, s);
+		} else if (i->second == types::DOUBLE) {
+			c = Z3_mk_fpa_numeral_double(ctx, v.floating, s);
+		} else {
+			c = Z3_mk_int64(ctx, v.integral, s);
+		}
+		prefs.push_back(Z3_mk_eq(ctx, x, c));
+	}
+	if (prefs.empty())
+		return false;
+
+	Z3_solver psol = Z3_mk_solver(ctx);
+	Z3_solver_inc_ref(ctx, psol);
+	Z3_params params = Z3_mk_params(ctx);
+	Z3_params_inc_ref(ctx, params);
+	Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "timeout"),
+			std::max((unsigned)kMinCoreTimeout, (unsigned)check_ms));
+	Z3_solver_set_params(ctx, psol, params);
+	Z3_params_dec_ref(ctx, params);
+
+	Z3_ast_vector as = Z3_solver_get_assertions(ctx, sol);
+	Z3_ast_vector_inc_ref(ctx, as);
+	for (unsigned j = 0; j < Z3_ast_vector_size(ctx, as); j++)
+		Z3_solver_assert(ctx, psol, Z3_ast_vector_get(ctx, as, j));
+	Z3_ast_vector_dec_ref(ctx, as);
+
+	bool found = false;
+	for (size_t round = 0; round < kMaxPreferRounds && !prefs.empty(); round++) {
+		Z3_lbool r = Z3_solver_check_assumptions(ctx, psol, prefs.size(), &prefs[0]);
+		if (r == Z3_L_TRUE) {
+			map<var_t,Value_t> pref_soln;
+			ReadModel(ctx, ctx, psol, vars, &pref_soln);
+			for (map<var_t,Value_t>::const_iterator i = pref_soln.begin();
+					i != pref_soln.end(); ++i)
+				(*soln)[i->first] = i->second;
+			found = true;
+		}
+		if (r != Z3_L_FALSE)
+			break;
+
+		// Give up one preference of the core at a time, so the others
+		// in it can still be kept.
+		vector<size_t> core;
+		ReadUnsatCore(ctx, psol, prefs, &core);
+		if (core.empty())
+			break;
+		prefs.erase(prefs.begin() + core.back());
+	}
+	Z3_solver_dec_ref(ctx, psol);
+	return found;
+}
+
+
+// Compares (wins + 1) / (attempts + 2), so a configuration that has
+// not been raced yet (1/2) ranks above one that keeps losing, and gets
+// its turn even when only a few are raced per query.
+bool Z3Solver::BetterWinRate(size_t a, size_t b) {
+	return ((portfolio_wins_[a] + 1) * (portfolio_attempts_[b] + 2)
+			> (portfolio_wins_[b] + 1) * (portfolio_attempts_[a] + 2));
+}
+
+
+void Z3Solver::FreePortfolioContexts(const vector<Z3_context>& ctxs) {
+	for (size_t i = 0; i < ctxs.size(); i++)
+		Z3_del_context(ctxs[i]);
+}
+
+
+void Z3Solver::PrintPortfolioStats() {
+	if (!portfolio_size_)
+		return;
+	fprintf(stderr, "Portfolio wins:");
+	for (size_t i = 0; i < kNumPortfolio; i++)
+		fprintf(stderr, " %s %zu/%zu", kPortfolio[i].name,
+				portfolio_wins_[i], portfolio_attempts_[i]);
+	fprintf(stderr, "\n");
+}
+
 long Z3Solver::Z3_running_time = 0;
 long Z3Solver::Z3_running_time2 = 0;
+unsigned Z3Solver::timeout_ms_ = 0;
+unsigned Z3Solver::rlimit_ = 0;
+bool Z3Solver::last_unknown_ = false;
+size_t Z3Solver::unknown_count_ = 0;
+long Z3Solver::unknown_time_ = 0;
 bool Z3Solver::IncrementalSolve(const vector<Value_t>& old_soln,
 		const map<var_t,type_t>& vars,
 		const vector<const SymbolicExpr*>& constraints,
@@ -123,29 +510,13 @@ bool Z3Solver::IncrementalSolve(const vector<Value_t>& old_soln,
 	return false;
 }
 
-bool Z3Solver::Solve(const map<var_t,type_t>& vars, const vector<unsigned long long>& values,
-		const vector<unsigned char>& hs, const vector<unsigned char> & ls,
-        const vector<SymbolicExpr*>& exprs,
-		const vector<const SymbolicExpr*>& constraints,
-		map<var_t,Value_t>* soln) {
-	long t, dt;
-	t = myclock();
-	//clock_t clk = clock();
-	global_numOfExpr_ = 0;
-	global_numOfVar_ = 0;
-	global_numOfOperator_ = 0;
-
+// Declares the inputs in x_decl, and asserts on sol that bitfields keep
+// their other bits and that floating-point inputs are not NaN or inf.
+void Z3Solver::DeclareVars(Z3_context ctx, Z3_solver sol,
+		const map<var_t,type_t>& vars, const vector<unsigned long long>& values,
+		const vector<unsigned char>& hs, const vector<unsigned char>& ls,
+		const vector<SymbolicExpr*>& exprs) {
 	typedef map<var_t,type_t>::const_iterator VarIt;
-	Z3_config cfg = Z3_mk_config();
-	Z3_set_param_value(cfg, "MODEL", "true");
-	//    Z3_set_param_value(cfg, "TYPE_CHECK", "false");
-	//    Z3_set_param_value(cfg, "WELL_SORTED_CHECK", "false");
-	Z3_context ctx = Z3_mk_context(cfg);
-	Z3_solver sol = Z3_mk_solver(ctx);
-	Z3_del_config(cfg);
-	assert(ctx);
-	
-	// Variable declarations.
 	for (VarIt i = vars.begin(); i != vars.end(); ++i){
 		char name[24];
 		sprintf(name, "x%u", i->first);
@@ -265,6 +636,156 @@ bool Z3Solver::Solve(const map<var_t,type_t>& vars, const vector<unsigned long l
 
 		assert(x_decl[i->first]);
 	}
+}
+
+
+// Reads the model of msol (in mctx) into soln.  The variables are
+// declared in ctx, and translated if mctx is another context.
+void Z3Solver::ReadModel(Z3_context ctx, Z3_context mctx, Z3_solver msol,
+		const map<var_t,type_t>& vars, map<var_t,Value_t>* soln) {
+	typedef map<var_t,type_t>::const_iterator VarIt;
+	Z3_model model = Z3_solver_get_model(mctx, msol);
+	assert(model);
+	Z3_model_inc_ref(mctx, model);
+	for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+		Value_t val = Value_t();
+		val.type = i->second;
+		Z3_ast v;
+		assert(Z3_model_eval(mctx, model, (mctx == ctx ? x_decl[i->first]
+					: Z3_translate(ctx, x_decl[i->first], mctx)), Z3_TRUE, &v));
+
+		Z3_sort_kind v_kind = Z3_get_sort_kind(mctx, Z3_get_sort(mctx, v));
+		if(v_kind == Z3_FLOATING_POINT_SORT){
+			long long unsigned int signi;
+			long long int expon;
+			int sign;
+			Z3_fpa_get_numeral_significand_uint64(mctx,v,&signi);
+			Z3_fpa_get_numeral_exponent_int64(mctx,v,&expon);
+			Z3_fpa_get_numeral_sign(mctx,v,&sign);
+
+			if(Z3_get_sort(mctx, v) == Z3_mk_fpa_sort_single(mctx)){
+				val.floating = setFloatByInts(sign,expon,signi);
+				val.type = types::FLOAT;
+			}else if(Z3_get_sort(mctx, v) == Z3_mk_fpa_sort_double(mctx)){
+				val.floating = setDoubleByInts(sign,expon,signi);
+				val.type = types::DOUBLE;
+			}
+#ifdef DEBUG
+			std::cerr<<"Solved floating value: "<<signi<<" "<<expon<<" "<<val.floating<<" SolvedValue\n";
+#endif
+		}else{
+			Z3_get_numeral_int64(mctx, v, &val.integral);
+			val.type = i->second; 
+			IFDEBUG(std::cerr<<"Solved int Value: "
+					<<val.integral<<" ty: "<<val.type<<"\n");
+		}
+		IFDEBUG(std::cerr<<Z3_ast_to_string(mctx,v)
+				<<" SolvedValue ty: "<<val.type<<"\n");
+		soln->insert(make_pair(i->first, val));
+		// Z3_del_model(mctx, model);
+	}
+	Z3_model_dec_ref(mctx, model);
+}
+
+
+// Checks the assertions of sol, whose constraints (the query proper) are
+// constraint_asts, and reads the model into soln if SAT.  See Solve for
+// unsat_core and preferred.
+Z3_lbool Z3Solver::CheckQuery(Z3_context ctx, Z3_solver sol,
+		const map<var_t,type_t>& vars,
+		const vector<const SymbolicExpr*>& constraints,
+		const vector<Z3_ast>& constraint_asts,
+		map<var_t,Value_t>* soln,
+		unsigned limit_scale,
+		vector<size_t>* unsat_core,
+		const vector<Value_t>* preferred) {
+	IFDEBUG(std::cerr << "Start evalution"<< std::endl);
+	//	std::cout<<"ConvertToSMT time "<<((double)clock() - clk)/CLOCKS_PER_SEC<<" constraint size "<<(int)(constraints.end() - constraints.begin() +1)<<" op "<<global_numOfOperator_<<" var "<<global_numOfVar_<<" clause "<<global_numOfExpr_<<std::endl;
+	long check_start = myclock();
+	// The answer, and its model, come from mctx/msol.
+	Z3_context mctx = ctx;
+	Z3_solver msol = sol;
+	vector<Z3_context> portfolio_ctxs;
+	Z3_lbool result;
+	if (portfolio_size_) {
+		result = PortfolioCheck(ctx, sol, limit_scale,
+				&portfolio_ctxs, &mctx, &msol);
+	} else {
+		result = Z3_solver_check(ctx, sol);
+	}
+	last_unknown_ = (result == Z3_L_UNDEF);
+	//	std::cout<<"Z3 solve time "<<((double)clock() - clk)/CLOCKS_PER_SEC<<std::endl;
+	IFDEBUG(std::cerr << "End evalution"<< std::endl);
+
+	switch(result){
+		case Z3_L_FALSE:
+			Z3Solver::reduction_unsat_formula_length += constraints.size();
+			Z3Solver::reduction_unsat_count++;
+			// Incremental floating-point checks rarely finish in time.
+			// DeclareVars pins the other bits of bitfield inputs to this
+			// execution's values, so a core over them may not hold for
+			// later executions.
+			if (unsat_core && !HasFloatVars(vars, constraints)
+					&& !HasBitfieldVars(vars, constraints))
+				ComputeUnsatCore(ctx, sol, constraint_asts,
+						myclock() - check_start, unsat_core);
+#ifdef DEBUG
+            std::cerr << "UNSAT" << std::endl;
+#endif
+			break;
+		case Z3_L_UNDEF:
+			unknown_count_++;
+			unknown_time_ += myclock() - check_start;
+			IFDEBUG(std::cerr << "UNKNOWN: "
+					<< Z3_solver_get_reason_unknown(ctx, sol) << std::endl);
+			break;
+		case Z3_L_TRUE:
+			ReadModel(ctx, mctx, msol, vars, soln);
+			// The model above stands if the preferences cannot be kept
+			// in time.
+			if (preferred != NULL && !HasFloatVars(vars, constraints))
+				PreferValues(ctx, sol, vars, *preferred,
+						myclock() - check_start, soln);
+			Z3Solver::reduction_sat_formula_length += constraints.size();
+			Z3Solver::reduction_sat_count++;
+#ifdef DEBUG
+            std::cerr << "SAT" << std::endl;
+#endif
+			break;
+	}
+	FreePortfolioContexts(portfolio_ctxs);
+	return result;
+}
+
+
+bool Z3Solver::Solve(const map<var_t,type_t>& vars, const vector<unsigned long long>& values,
+		const vector<unsigned char>& hs, const vector<unsigned char> & ls,
+        const vector<SymbolicExpr*>& exprs,
+		const vector<const SymbolicExpr*>& constraints,
+		map<var_t,Value_t>* soln,
+		unsigned limit_scale,
+		vector<size_t>* unsat_core,
+		const vector<Value_t>* preferred) {
+	long t, dt;
+	t = myclock();
+	//clock_t clk = clock();
+	global_numOfExpr_ = 0;
+	global_numOfVar_ = 0;
+	global_numOfOperator_ = 0;
+
+	Z3_config cfg = Z3_mk_config();
+	Z3_set_param_value(cfg, "MODEL", "true");
+	//    Z3_set_param_value(cfg, "TYPE_CHECK", "false");
+	//    Z3_set_param_value(cfg, "WELL_SORTED_CHECK", "false");
+	Z3_context ctx = Z3_mk_context(cfg);
+	Z3_solver sol = Z3_mk_solver(ctx);
+	Z3_solver_inc_ref(ctx, sol);
+	Z3_del_config(cfg);
+	assert(ctx);
+
+	SetLimits(ctx, sol, limit_scale);
+	
+	DeclareVars(ctx, sol, vars, values, hs, ls, exprs);
 
 #ifdef DEBUG
 	string s = "";
@@ -283,6 +804,7 @@ bool Z3Solver::Solve(const map<var_t,type_t>& vars, const vector<unsigned long l
 
 	//Z3_ast* constraints_ast = new Z3_ast[constraints.size()];
 
+	vector<Z3_ast> constraint_asts;
 	for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
 		const SymbolicExpr& se = **i;
 		global_numOfExpr_++;
@@ -295,73 +817,14 @@ bool Z3Solver::Solve(const map<var_t,type_t>& vars, const vector<unsigned long l
 #ifdef DEBUG
 		std::cerr << "(" << (i - constraints.begin())+1 << ") " << Z3_ast_to_string(ctx, e) << std::endl;
 #endif
+		constraint_asts.push_back(e);
 		Z3_solver_assert(ctx, sol,e);
 		//		constraints_ast[i-constraints.begin()] = e;
 	}
 
-	IFDEBUG(std::cerr << "Start evalution"<< std::endl);
-	//	std::cout<<"ConvertToSMT time "<<((double)clock() - clk)/CLOCKS_PER_SEC<<" constraint size "<<(int)(constraints.end() - constraints.begin() +1)<<" op "<<global_numOfOperator_<<" var "<<global_numOfVar_<<" clause "<<global_numOfExpr_<<std::endl;
-	Z3_lbool result = Z3_solver_check(ctx, sol);
-	Z3_model model = 0;
-	//	std::cout<<"Z3 solve time "<<((double)clock() - clk)/CLOCKS_PER_SEC<<std::endl;
-	IFDEBUG(std::cerr << "End evalution"<< std::endl);
-
-	switch(result){
-		case Z3_L_FALSE:
-			Z3Solver::reduction_unsat_formula_length += constraints.size();
-			Z3Solver::reduction_unsat_count++;
-#ifdef DEBUG
-            std::cerr << "UNSAT" << std::endl;
-#endif
-			break;
-		case Z3_L_UNDEF:
-			break;
-		case Z3_L_TRUE:
-			model = Z3_solver_get_model(ctx, sol);
-			assert(model);
-			for (VarIt i = vars.begin(); i != vars.end(); ++i) {
-				Value_t val = Value_t();
-				val.type = i->second;
-				Z3_ast v;
-				assert(Z3_model_eval(ctx, model, x_decl[i->first], Z3_TRUE, &v));
-
-				Z3_sort_kind v_kind = Z3_get_sort_kind(ctx, Z3_get_sort(ctx, v));
-				if(v_kind == Z3_FLOATING_POINT_SORT){
-					long long unsigned int signi;
-					long long int expon;
-					int sign;
-					Z3_fpa_get_numeral_significand_uint64(ctx,v,&signi);
-					Z3_fpa_get_numeral_exponent_int64(ctx,v,&expon);
-					Z3_fpa_get_numeral_sign(ctx,v,&sign);
-
-					if(Z3_get_sort(ctx, v) == Z3_mk_fpa_sort_single(ctx)){
-						val.floating = setFloatByInts(sign,expon,signi);
-						val.type = types::FLOAT;
-					}else if(Z3_get_sort(ctx, v) == Z3_mk_fpa_sort_double(ctx)){
-						val.floating = setDoubleByInts(sign,expon,signi);
-						val.type = types::DOUBLE;
-					}
-#ifdef DEBUG
-					std::cerr<<"Solved floating value: "<<signi<<" "<<expon<<" "<<val.floating<<" SolvedValue\n";
-#endif
-				}else{
-					Z3_get_numeral_int64(ctx, v, &val.integral);
-					val.type = i->second; 
-					IFDEBUG(std::cerr<<"Solved int Value: "
-							<<val.integral<<" ty: "<<val.type<<"\n");
-				}
-				IFDEBUG(std::cerr<<Z3_ast_to_string(ctx,v)
-						<<" SolvedValue ty: "<<val.type<<"\n");
-				soln->insert(make_pair(i->first, val));
-				// Z3_del_model(ctx, model);
-			}
-			Z3Solver::reduction_sat_formula_length += constraints.size();
-			Z3Solver::reduction_sat_count++;
-#ifdef DEBUG
-            std::cerr << "SAT" << std::endl;
-#endif
-			break;
-	}
+	Z3_lbool result = CheckQuery(ctx, sol, vars, constraints, constraint_asts,
+			soln, limit_scale, unsat_core, preferred);
+	Z3_solver_dec_ref(ctx, sol);
 	Z3_del_context(ctx);
 	Z3_reset_memory();
 
@@ -371,5 +834,98 @@ bool Z3Solver::Solve(const map<var_t,type_t>& vars, const vector<unsigned long l
 	return (result == Z3_L_TRUE);
 }
 
-}  // namespace crown
 
+// Negation of a converted constraint, as UnaryExpr's LOGICAL_NOT builds it.
+static Z3_ast NegateAST(Z3_context ctx, Z3_ast e) {
+	Z3_sort s = Z3_get_sort(ctx, e);
+	if (Z3_get_sort_kind(ctx, s) == Z3_BV_SORT) {
+		return Z3_mk_ite(ctx, Z3_mk_eq(ctx, e, Z3_mk_int(ctx, 0, s)),
+				Z3_mk_true(ctx), Z3_mk_false(ctx));
+	}
+	return Z3_mk_not(ctx, e);
+}
+
+
+void Z3Solver::SolveBatch(const map<var_t,type_t>& vars, const vector<unsigned long long>& values,
+		const vector<unsigned char>& hs, const vector<unsigned char>& ls,
+		const vector<SymbolicExpr*>& exprs,
+		const vector<SymbolicExpr*>& path,
+		vector<BatchQuery>* queries,
+		const vector<Value_t>* preferred) {
+	if (queries->empty())
+		return;
+	long t, dt;
+	t = myclock();
+	global_numOfExpr_ = 0;
+	global_numOfVar_ = 0;
+	global_numOfOperator_ = 0;
+
+	size_t end = 0;
+	for (size_t q = 0; q < queries->size(); q++)
+		end = std::max(end, (*queries)[q].index + 1);
+	assert(end <= path.size());
+
+	Z3_config cfg = Z3_mk_config();
+	Z3_set_param_value(cfg, "MODEL", "true");
+	Z3_context ctx = Z3_mk_context(cfg);
+	Z3_del_config(cfg);
+	assert(ctx);
+
+	// Everything is converted once, into a solver that is never checked.
+	// marks[i] is the number of its assertions that constraint i needs:
+	// the declarations and the side conditions of constraints 0..i.
+	Z3_solver all = Z3_mk_solver(ctx);
+	Z3_solver_inc_ref(ctx, all);
+	DeclareVars(ctx, all, vars, values, hs, ls, exprs);
+	vector<Z3_ast> path_asts;
+	vector<unsigned> marks;
+	for (size_t i = 0; i < end; i++) {
+		global_numOfExpr_++;
+		Z3_ast e = path[i]->ConvertToSMT(ctx, all);
+		IFDEBUG(std::cerr << "(" << i+1 << ") " << Z3_ast_to_string(ctx, e) << std::endl);
+		Z3_ast_vector as = Z3_solver_get_assertions(ctx, all);
+		Z3_ast_vector_inc_ref(ctx, as);
+		marks.push_back(Z3_ast_vector_size(ctx, as));
+		Z3_ast_vector_dec_ref(ctx, as);
+		path_asts.push_back(e);
+		Z3_solver_assert(ctx, all, e);
+	}
+	Z3_ast_vector as = Z3_solver_get_assertions(ctx, all);
+	Z3_ast_vector_inc_ref(ctx, as);
+
+	// Each query gets a fresh solver: reusing one with push/pop would
+	// put Z3 in its incremental mode, which is slow on floating point.
+	for (size_t q = 0; q < queries->size(); q++) {
+		BatchQuery& bq = (*queries)[q];
+		Z3_solver sol = Z3_mk_solver(ctx);
+		Z3_solver_inc_ref(ctx, sol);
+		SetLimits(ctx, sol, bq.limit_scale);
+		for (unsigned j = 0; j < marks[bq.index]; j++)
+			Z3_solver_assert(ctx, sol, Z3_ast_vector_get(ctx, as, j));
+		vector<Z3_ast> constraint_asts(path_asts.begin(),
+				path_asts.begin() + bq.index + 1);
+		constraint_asts.back() = NegateAST(ctx, constraint_asts.back());
+		for (size_t j = 0; j < constraint_asts.size(); j++)
+			Z3_solver_assert(ctx, sol, constraint_asts[j]);
+
+		vector<const SymbolicExpr*> constraints(path.begin(),
+				path.begin() + bq.index + 1);
+		bq.soln.clear();
+		bq.core.clear();
+		Z3_lbool result = CheckQuery(ctx, sol, vars, constraints, constraint_asts,
+				&bq.soln, bq.limit_scale, &bq.core, preferred);
+		bq.sat = (result == Z3_L_TRUE);
+		bq.unknown = (result == Z3_L_UNDEF);
+		Z3_solver_dec_ref(ctx, sol);
+	}
+
+	Z3_ast_vector_dec_ref(ctx, as);
+	Z3_solver_dec_ref(ctx, all);
+	Z3_del_context(ctx);
+	Z3_reset_memory();
+
+	dt = myclock() - t;
+	Z3_running_time += dt;
+}
+
+}  // namespace crown
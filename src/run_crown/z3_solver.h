@@ -44,13 +44,95 @@ class Z3Solver {
 			 const vector<const SymbolicExpr*>& constraints,
 			 map<var_t,Value_t>* soln);  //doesn't using it.
 
+	 // If the query is UNSAT and unsat_core is given, it receives the
+	 // indices of constraints that are UNSAT on their own (none if they
+	 // involve floating-point or bitfield inputs).  If preferred
+	 // is given, inputs are kept at those values where the constraints
+	 // allow it.
 	 static bool Solve(const map<var_t,type_t>& vars, const vector<unsigned long long>& values,
 				const vector<unsigned char>& hs, const vector <unsigned char>& ls, const vector <SymbolicExpr *>& exprs,
 			 const vector<const SymbolicExpr*>& constraints,
-			 map<var_t,Value_t>* soln);
+			 map<var_t,Value_t>* soln,
+			 unsigned limit_scale = 1,
+			 vector<size_t>* unsat_core = NULL,
+			 const vector<Value_t>* preferred = NULL);
+
+	 // One query of SolveBatch: path[0..index] with path[index] negated.
+	 struct BatchQuery {
+		 size_t index;
+		 unsigned limit_scale;
+		 bool sat;
+		 bool unknown;
+		 map<var_t,Value_t> soln;
+		 vector<size_t> core;  // as unsat_core of Solve
+	 };
+
+	 // Solves several flips of one path, converting the path to SMT
+	 // only once.
+	 static void SolveBatch(const map<var_t,type_t>& vars, const vector<unsigned long long>& values,
+			 const vector<unsigned char>& hs, const vector<unsigned char>& ls,
+			 const vector<SymbolicExpr*>& exprs,
+			 const vector<SymbolicExpr*>& path,
+			 vector<BatchQuery>* queries,
+			 const vector<Value_t>* preferred = NULL);
+
 	 static long GetRunningTime(){ return Z3_running_time;};
 
+	 // Per-query limits (0 = none), multiplied by Solve's limit_scale.
+	 // A query that hits one comes back UNKNOWN.
+	 static unsigned timeout_ms_;
+	 static unsigned rlimit_;
+
+	 // Whether the last Solve came back UNKNOWN, and the number of and
+	 // time (ms) spent in all such queries.
+	 static bool last_unknown_;
+	 static size_t unknown_count_;
+	 static long unknown_time_;
+
+	 // Number of solver configurations raced per query (0 = portfolio
+	 // off), and how often each configuration was raced and answered
+	 // first.  The ones with the best win rate are picked when not all
+	 // of them are raced.
+	 static size_t portfolio_size_;
+	 static vector<size_t> portfolio_wins_;
+	 static vector<size_t> portfolio_attempts_;
+	 static void PrintPortfolioStats();
+
  private:
+	 static void DeclareVars(Z3_context ctx, Z3_solver sol,
+			 const map<var_t,type_t>& vars, const vector<unsigned long long>& values,
+			 const vector<unsigned char>& hs, const vector<unsigned char>& ls,
+			 const vector<SymbolicExpr*>& exprs);
+	 static Z3_lbool CheckQuery(Z3_context ctx, Z3_solver sol,
+			 const map<var_t,type_t>& vars,
+			 const vector<const SymbolicExpr*>& constraints,
+			 const vector<Z3_ast>& constraint_asts,
+			 map<var_t,Value_t>* soln,
+			 unsigned limit_scale,
+			 vector<size_t>* unsat_core,
+			 const vector<Value_t>* preferred);
+	 static void SetLimits(Z3_context ctx, Z3_solver sol, unsigned limit_scale);
+	 static Z3_lbool PortfolioCheck(Z3_context ctx, Z3_solver sol,
+			 unsigned limit_scale, vector<Z3_context>* ctxs,
+			 Z3_context* wctx, Z3_solver* wsol);
+	 static void ReadUnsatCore(Z3_context ctx, Z3_solver sol,
+			 const vector<Z3_ast>& lits, vector<size_t>* core);
+	 static const unsigned kMinCoreTimeout = 10;
+	 static bool HasFloatVars(const map<var_t,type_t>& vars,
+			 const vector<const SymbolicExpr*>& constraints);
+	 static bool HasBitfieldVars(const map<var_t,type_t>& vars,
+			 const vector<const SymbolicExpr*>& constraints);
+	 static void ComputeUnsatCore(Z3_context ctx, Z3_solver sol,
+			 const vector<Z3_ast>& cs, long check_ms, vector<size_t>* core);
+	 static const size_t kMaxPreferRounds = 8;
+	 static bool PreferValues(Z3_context ctx, Z3_solver sol,
+			 const map<var_t,type_t>& vars, const vector<Value_t>& preferred,
+			 long check_ms, map<var_t,Value_t>* soln);
+	 static void ReadModel(Z3_context ctx, Z3_context mctx, Z3_solver msol,
+			 const map<var_t,type_t>& vars, map<var_t,Value_t>* soln);
+	 static bool BetterWinRate(size_t a, size_t b);
+	 static void FreePortfolioContexts(const vector<Z3_context>& ctxs);
+
 	 static long Z3_running_time;
 	 static long Z3_running_time2;
 };